@@ -19,6 +19,9 @@
 #include <arduino.h>
 #include "src/power.h"
 #include "src/safety.h"
+#include "src/capture.h"
+#include "src/trace.h"
+#include "src/analog.h"
 
 /////////////////////////
 // CONFIGURATION VARIABLES
@@ -35,9 +38,42 @@ const long OVERSHOOT_BUFFER = 500;
 const long UNDERSHOOT_BUFFER = 500;
 
 // State delays
+// If grab confirmation is enabled, a waypoint that turns on the magnet ends its dwell as soon as
+// the magnet load is confirmed, but no sooner than MAGNET_GRAB_DELAY.
 const unsigned int MAGNET_GRAB_DELAY = 250;
 const unsigned int MOTOR_GRAB_DELAY = 500;
 const unsigned int MOTOR_IDLE_DELAY = 2000;
+const unsigned int MOTOR_QUEUE_DELAY = 500;
+
+// GO presses are latched at any time, up to GO_QUEUE_DEPTH cycles ahead.
+// Cycles requested while another cycle is running start MOTOR_QUEUE_DELAY after it ends;
+// other cycles start MOTOR_IDLE_DELAY after the last cycle ends.
+// In demo mode, cycles run continuously, MOTOR_QUEUE_DELAY apart.
+const byte GO_QUEUE_DEPTH = 3;
+const bool DEMO_MODE = false;
+
+// Automatic fault recovery
+// After a motor fault, the motor waits RECOVERY_BACKOFF_DELAY (doubled for each other fault within
+// FAULT_WINDOW), reverses RECOVERY_REVERSE_DISTANCE, re-homes at SLOW speed, and retries any
+// interrupted cycle at MEDIUM speed. A fault beyond FAULT_BUDGET faults within FAULT_WINDOW is
+// latched until cleared by the FORW and/or BACK button.
+#define FAULT_BUDGET 3
+const unsigned long FAULT_WINDOW = 600000;
+const unsigned int RECOVERY_BACKOFF_DELAY = 2000;
+const long RECOVERY_REVERSE_DISTANCE = 2000;
+
+// The most recent RECOVERY_RECORDS recovery attempts are kept, and printed with the 'R' command
+#define RECOVERY_RECORDS 4
+
+// Grab confirmation, using a magnet current or load signal on GRAB_SENSE_CHANNEL (see analog.h)
+// The load is confirmed once the averaged reading is at least GRAB_LOAD_THRESHOLD
+// The host tests enable it by defining GRAB_SENSE when building
+#ifdef GRAB_SENSE
+const bool GRAB_SENSE_ENABLED = true;
+#else
+const bool GRAB_SENSE_ENABLED = false;
+#endif
+const uint16_t GRAB_LOAD_THRESHOLD = 512;
 
 
 /////////////////////////
@@ -62,24 +98,122 @@ typedef enum {
 	FORW,
 	BACK,
 	ENDSTOP_0,
+	GRAB_LOAD,
 	ENDSTOP_1  // Unused
 } sensor_t;
 
 typedef enum {
 	INIT,
 	IDLE,
-	DOWN,
-	GRAB,
-	UP,
+	DOWN,      // Moving to a waypoint
+	GRAB,      // Dwelling at a waypoint
+	UP,        // Returning home after the last waypoint
 	OVERRIDE,
+	RECOVER,
 	FAULTED
 } state_t;
 
+typedef enum {
+	BOOT_SERIAL,
+	BOOT_INPUTS,
+	BOOT_SAFETY,
+	BOOT_POWER,
+	BOOT_DIAGNOSTICS,
+	BOOT_SUPERVISOR,
+	BOOT_ENCODER     // Started by loop(), once the encoder pins have settled
+} boot_phase_t;
+
+#define BOOT_PHASES 7
+const char BOOT_PHASE_NAMES[BOOT_PHASES][11] PROGMEM = {
+	"SERIAL", "INPUTS", "SAFETY", "POWER", "DIAG", "SUPERVISOR", "ENCODER"
+};
+
+typedef enum {
+	BACKOFF,
+	REVERSE,
+	REHOME
+} recovery_phase_t;
+
+typedef enum {
+	RECOVERY_PENDING,    // Still recovering
+	RECOVERY_DONE,       // Re-homed successfully
+	RECOVERY_FAULTED,    // Faulted again while recovering
+	RECOVERY_CANCELLED,  // Interrupted by the FORW or BACK button
+	RECOVERY_LATCHED     // Not attempted, as the fault budget was exceeded
+} recovery_outcome_t;
+
+const char RECOVERY_OUTCOME_NAMES[5][10] PROGMEM = {
+	"PENDING", "RECOVERED", "FAULTED", "CANCELLED", "LATCHED"
+};
+
+
+/////////////////////////
+// DATA STRUCTURES
+/////////////////////////
+
+typedef struct {
+	unsigned long time;      // Milliseconds since reset
+	long position;
+	unsigned long delay;     // Back-off time, in milliseconds
+	byte attempt;            // Faults within FAULT_WINDOW, including this one
+	byte state;              // State that faulted (see state_t)
+	byte outcome;            // See recovery_outcome_t
+} recovery_record_t;
+
+
+/////////////////////////
+// MOTION SEQUENCE
+/////////////////////////
+
+// Each cycle visits every waypoint in order, then returns home at SEQUENCE_HOME_SPEED.
+// The magnet is set when a waypoint is reached, and the motor stops there for the dwell time.
+// With no dwell, the motor continues straight to the next waypoint, without stopping if it
+// continues in the same direction. Positions are limited to 0 through MOTOR_MAX_MOVEMENT, and
+// reaching the endstop while moving backward ends the cycle early.
+typedef struct {
+	long position;
+	motor_speed_t speed;
+	bool magnet;
+	unsigned int dwell;
+} waypoint_t;
+
+const waypoint_t SEQUENCE[] PROGMEM = {
+	{MOTOR_TRAVEL_TARGET, FAST, true, MOTOR_GRAB_DELAY}
+};
+const byte SEQUENCE_LENGTH = (sizeof(SEQUENCE) / sizeof(waypoint_t));
+const motor_speed_t SEQUENCE_HOME_SPEED = FAST;
+
+
+/////////////////////////
+// DIAGNOSTIC CONFIGURATION
+/////////////////////////
+
+// Entering this state triggers a motion capture, if CAPTURE_STATE is enabled in CAPTURE_TRIGGERS (see capture.h)
+const state_t CAPTURE_TRIGGER_STATE = GRAB;
+
 
 /////////////////////////
 // INTERNAL FUNCTIONS
 /////////////////////////
 
+void markBootPhase(boot_phase_t phase);
+/*
+ * Records the time at which a startup phase completed
+ *
+ * Affects Boot_Times[]
+ * INPUT:  Completed startup phase
+ */
+
+void reportBoot();
+/*
+ * Prints the completion time of each startup phase, in microseconds since reset
+ *
+ * The report doesn't fit in the serial transmit buffer, so the time at which it has been queued is
+ * also recorded, and printed once the Firmware is ready.
+ *
+ * Affects Boot_Report_Time
+ */
+
 void initInputs();
 /*
  * Initializes input pins
@@ -88,6 +222,96 @@ void initInputs();
  * Initialization involves endstop and button pin configuration.
  */
 
+void changeState(state_t state);
+/*
+ * Moves the state machine to a new state
+ *
+ * Affects Current_State
+ * INPUT:  New state
+ */
+
+void clearGoRequests();
+/*
+ * Discards all queued GO requests
+ * Used when the cycle is interrupted by an override or fault
+ *
+ * Affects Go_Requests, Go_Back_To_Back
+ */
+
+void startSequence(motor_speed_t speed_limit);
+/*
+ * Starts a cycle from the first waypoint of the motion sequence
+ *
+ * Affects Sequence_Index, Sequence_Speed_Limit
+ * INPUT:  Fastest speed allowed during the cycle
+ */
+
+void startSegment();
+/*
+ * Starts moving to the current waypoint, or home if there are no more waypoints
+ *
+ * Affects Segment, Segment_Movement, Segment_Grab, State_Start, Current_State
+ */
+
+void startRecovery();
+/*
+ * Begins automatic recovery from a motor fault, or latches the fault if over budget
+ * Used by the FAULTED state
+ *
+ * Either way, the attempt is recorded with recordRecovery().
+ *
+ * Affects Fault_Times[], Fault_Count, Fault_Ptr, Fault_Latched, Recovery_Phase,
+ * Recovery_Movement, Recovery_Retry, Recovery_Delay, Is_Faulted
+ */
+
+void recordRecovery(byte attempt, unsigned long delay, recovery_outcome_t outcome);
+/*
+ * Records a recovery attempt from the fault in Faulted_State, replacing the oldest record if full
+ * Any earlier attempt still pending is recorded as having faulted again
+ *
+ * Affects Recovery_Records[], Recovery_Record_Ptr, Recovery_Record_Count, Recovery_Total
+ * INPUT:  Attempt number, back-off time in milliseconds, outcome so far
+ */
+
+void endRecovery(recovery_outcome_t outcome);
+/*
+ * Records the outcome of the latest recovery attempt, if it is still pending
+ *
+ * Affects Recovery_Records[]
+ * INPUT:  Outcome
+ */
+
+void printRecoveries();
+/*
+ * Prints the number of recovery attempts since startup, and the most recent attempts, oldest first
+ */
+
+void clearFaultHistory();
+/*
+ * Forgets all previous faults and unlatches any latched fault
+ * Used when faults are cleared by an operator
+ *
+ * Affects Fault_Count, Fault_Ptr, Fault_Latched, Recovery_Retry
+ */
+
+void handleSerialInput();
+/*
+ * Handles single-character commands received over serial
+ *
+ * 'E' prints the error code registry.
+ * 'I' prints encoder signal integrity statistics.
+ * 'R' prints the recovery attempt records.
+ */
+
+byte updateSensors();
+/*
+ * Debounces all sensors, engaging each once it reads engaged SENSOR_REQUIRED_COUNT times in a row
+ * Must be called once per loop
+ *
+ * Affects Sensor_Count[], Sensor_Engaged[]
+ * OUTPUT: Bitmask of engaged sensors
+ */
+
 bool sensorEngagedCurrent(sensor_t sensor);
 /*
  * Gets the immediate state of a given sensor
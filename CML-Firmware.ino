@@ -1,40 +1,102 @@
 #include "CML-Firmware.h"
 
-unsigned int Sensor_Count[4] = {0, 0, 0, 0};
-bool Sensor_Engaged[4] = {false, false, false, false};
+unsigned int Sensor_Count[5] = {0, 0, 0, 0, 0};
+bool Sensor_Engaged[5] = {false, false, false, false, false};
 motor_movement_t Override_Type = HALT;
 state_t Current_State = INIT;
 
+byte Go_Requests = 0;
+bool Go_Back_To_Back = false;
+bool Go_Engaged_Prev = false;
+
+byte Sequence_Index = 0;
+motor_speed_t Sequence_Speed_Limit = FAST;
+waypoint_t Segment;
+motor_movement_t Segment_Movement = FORWARD;
+bool Segment_Grab = false;
+
+state_t Faulted_State = INIT;
+unsigned long Fault_Times[FAULT_BUDGET];
+byte Fault_Count = 0;
+byte Fault_Ptr = 0;
+bool Fault_Latched = false;
+recovery_phase_t Recovery_Phase = BACKOFF;
+motor_movement_t Recovery_Movement = HALT;
+bool Recovery_Retry = false;
+unsigned long Recovery_Delay = 0;
+long Recovery_Start_Pos = 0;
+recovery_record_t Recovery_Records[RECOVERY_RECORDS];
+byte Recovery_Record_Ptr = 0;    // Index of the next record to write
+byte Recovery_Record_Count = 0;
+unsigned int Recovery_Total = 0;
+
 unsigned long State_Start = 0;
 
+unsigned long Boot_Times[BOOT_PHASES];
+unsigned long Boot_Report_Time = 0;
+bool Boot_Ready = false;
+bool Encoder_Started = false;
+
 void setup() {
 	Serial.begin(115200);
+	markBootPhase(BOOT_SERIAL);
 	initInputs();
+	markBootPhase(BOOT_INPUTS);
 	initWatchdog();
+	markBootPhase(BOOT_SAFETY);
+
+	// Switch the relay now if the bucket needs homing, so homing can start once it settles
 	initPowerOutputs();
 	setMotorSpeed(SLOW);
-	setMotorOutput(BACKWARD);
+	if(!sensorEngagedCurrent(ENDSTOP_0)) {
+		prepareMotorOutput(BACKWARD);
+	}
+	markBootPhase(BOOT_POWER);
+
+	initCapture();
+	if(GRAB_SENSE_ENABLED || SUPPLY_SENSE_ENABLED) {
+		initAnalog();
+	}
+	initTrace();
+	markBootPhase(BOOT_DIAGNOSTICS);
+	initSupervisor();
+	markBootPhase(BOOT_SUPERVISOR);
 }
 
 void loop() {
+	checkInSupervisor(HEARTBEAT_LOOP);
 
-	// Handle endstop sensing
-	for(byte Sensor = 0; Sensor <= ENDSTOP_0; Sensor++) {
-		if(sensorEngagedCurrent(Sensor)) {
-			if(++Sensor_Count[Sensor] >= SENSOR_REQUIRED_COUNT) {
-				Sensor_Engaged[Sensor] = true;
-				Sensor_Count[Sensor] -= 1;
-			}
+	// Start the encoder once its pins have settled, before anything can move the motor
+	// The first move waits far longer than this for the relay, so startup isn't delayed
+	if(!Encoder_Started) {
+		if(!encoderSettled()) {
+			return;
 		}
-		else {
-			Sensor_Engaged[Sensor] = false;
-			Sensor_Count[Sensor] = 0;
+		startEncoder();
+		Encoder_Started = true;
+		markBootPhase(BOOT_ENCODER);
+		reportBoot();
+	}
+	handleTrace();
+	handleSerialInput();
+	handleSupplyVoltage();
+
+	// Handle endstop sensing
+	setCaptureSensors(updateSensors());
+
+	// Handle GO requests
+	if(Sensor_Engaged[GO] && !Go_Engaged_Prev && (Go_Requests < GO_QUEUE_DEPTH)) {
+		Go_Requests += 1;
+		if(Current_State != IDLE) {
+			Go_Back_To_Back = true;
 		}
 	}
+	Go_Engaged_Prev = Sensor_Engaged[GO];
 
 	// Handle motor faults
-	if(isFaulted()) {
-		Current_State = FAULTED;
+	if(isFaulted() && (Current_State != FAULTED)) {
+		Faulted_State = Current_State;
+		changeState(FAULTED);
 	}
 
 	// Handle motor overrides
@@ -49,11 +111,14 @@ void loop() {
 			Override_Type = BACKWARD;
 		}
 		clearFaults();
-		Current_State = OVERRIDE;
+		clearFaultHistory();
+		clearGoRequests();
+		endRecovery(RECOVERY_CANCELLED);
+		changeState(OVERRIDE);
 	}
 	else if(Current_State == OVERRIDE) {
 		setMotorOutput(HALT);
-		Current_State = IDLE;
+		changeState(IDLE);
 	}
 
 	// State machine
@@ -62,37 +127,69 @@ void loop() {
 			if(Sensor_Engaged[ENDSTOP_0]) {
 				setMotorOutput(HALT);
 				homeEncoder();
+				if(!Boot_Ready) {
+					Boot_Ready = true;
+					Serial.print(F("READY: "));
+					Serial.print(millis());
+					Serial.print(F(" ms, BOOT REPORTED: "));
+					Serial.print(Boot_Report_Time);
+					Serial.print(F(" us\n\n"));
+				}
 				State_Start = millis();
-				Current_State = IDLE;
+				changeState(IDLE);
+			}
+			else if(!motorEnabled() && motorOutputReady()) {
+				setMotorOutput(BACKWARD);
 			}
 			break;
 		}
 		case IDLE: {
-			if(Sensor_Engaged[GO] && ((millis() - State_Start) >= MOTOR_IDLE_DELAY)) {
-				State_Start = millis();
-				setMotorSpeed(FAST);
-				setMotorOutput(FORWARD);
-				Current_State = DOWN;
+			if(captureReady()) {
+				dumpCapture();
+			}
+			unsigned int Idle_Delay = ((Go_Back_To_Back || DEMO_MODE) ? MOTOR_QUEUE_DELAY : MOTOR_IDLE_DELAY);
+			if(((Go_Requests > 0) || DEMO_MODE) && ((millis() - State_Start) >= Idle_Delay)) {
+				if(Go_Requests > 0) {
+					Go_Requests -= 1;
+				}
+				Go_Back_To_Back = (Go_Requests > 0);
+				startSequence(FAST);
 			}
 			break;
 		}
 		case DOWN: {
-			if(getEncoderPos() >= MOTOR_TRAVEL_TARGET) {
-				setMotorOutput(HALT);
-				setMagnetOutput(true);
-				Serial.print("TRAVEL TIME: ");
+			long Position = getEncoderPos();
+			if((Segment_Movement == BACKWARD) && (Sensor_Engaged[ENDSTOP_0] || (Position <= -OVERSHOOT_BUFFER))) {
+				// End the cycle early; UP handles the endstop or overshoot
+				changeState(UP);
+			}
+			else if((Segment_Movement == FORWARD) ? (Position >= Segment.position) : (Position <= Segment.position)) {
+				Serial.print(F("SEGMENT "));
+				Serial.print(Sequence_Index);
+				Serial.print(F(" TIME: "));
 				Serial.print(millis() - State_Start);
-				Serial.print("\n");
-				State_Start = millis();
-				Current_State = GRAB;
+				Serial.print(F("\n"));
+				Segment_Grab = (Segment.magnet && !magnetEnabled());
+				if(Segment.magnet != magnetEnabled()) {
+					setMagnetOutput(Segment.magnet);
+				}
+				if(Segment.dwell > 0) {
+					setMotorOutput(HALT);
+					State_Start = millis();
+					changeState(GRAB);
+				}
+				else {
+					Sequence_Index += 1;
+					startSegment();
+				}
 			}
 			break;
 		}
 		case GRAB: {
-			if((millis() - State_Start) >= MOTOR_GRAB_DELAY) {
-				setMotorOutput(BACKWARD);
-				State_Start = millis();
-				Current_State = UP;
+			unsigned long Dwell_Elapsed_Time = millis() - State_Start;
+			if((Segment_Grab && (Dwell_Elapsed_Time >= MAGNET_GRAB_DELAY) && Sensor_Engaged[GRAB_LOAD]) || (Dwell_Elapsed_Time >= Segment.dwell)) {
+				Sequence_Index += 1;
+				startSegment();
 			}
 			break;
 		}
@@ -101,27 +198,29 @@ void loop() {
 				setMotorOutput(HALT);
 				setMagnetOutput(false);
 				flagError(2);
-				Serial.print("END @ POS: ");
+				triggerCapture(CAPTURE_OVERSHOOT);
+				Serial.print(F("END @ POS: "));
 				Serial.print(getEncoderPos());
-				Serial.print(" (OVERSHOT!)\n\n");
+				Serial.print(F(" (OVERSHOT!)\n\n"));
 				State_Start = millis();
-				Current_State = IDLE;
+				changeState(IDLE);
 			}
 			else if(Sensor_Engaged[ENDSTOP_0]) {
 				setMotorOutput(HALT);
 				setMagnetOutput(false);
-				Serial.print("END @ POS: ");
+				Serial.print(F("END @ POS: "));
 				Serial.print(getEncoderPos());
 
 				if(getEncoderPos() >= UNDERSHOOT_BUFFER) {
 					flagError(1);
-					Serial.print(" (UNDERSHOT!)");
+					triggerCapture(CAPTURE_UNDERSHOOT);
+					Serial.print(F(" (UNDERSHOT!)"));
 				}
 
-				Serial.print("\n\n");
+				Serial.print(F("\n\n"));
 				homeEncoder();
 				State_Start = millis();
-				Current_State = IDLE;
+				changeState(IDLE);
 			}
 			break;
 		}
@@ -154,15 +253,78 @@ void loop() {
 			}
 			break;
 		}
+		case RECOVER: {
+			switch(Recovery_Phase) {
+				case BACKOFF:
+					if((millis() - State_Start) >= Recovery_Delay) {
+						Recovery_Start_Pos = getEncoderPos();
+						setMotorSpeed(SLOW);
+						setMotorOutput(Recovery_Movement);
+						Recovery_Phase = REVERSE;
+					}
+					break;
+				case REVERSE:
+					if((abs(getEncoderPos() - Recovery_Start_Pos) >= RECOVERY_REVERSE_DISTANCE)
+						|| ((Recovery_Movement == FORWARD) && (getEncoderPos() >= MOTOR_MAX_MOVEMENT))
+						|| ((Recovery_Movement == BACKWARD) && Sensor_Engaged[ENDSTOP_0])) {
+						setMotorOutput(BACKWARD);
+						Recovery_Phase = REHOME;
+					}
+					break;
+				default:
+				case REHOME:
+					if(Sensor_Engaged[ENDSTOP_0]) {
+						setMotorOutput(HALT);
+						homeEncoder();
+						endRecovery(RECOVERY_DONE);
+						Serial.print(F("RECOVERED\n\n"));
+						State_Start = millis();
+						if(Recovery_Retry) {
+							Recovery_Retry = false;
+							startSequence(MEDIUM);
+						}
+						else {
+							changeState(IDLE);
+						}
+					}
+					break;
+			}
+			break;
+		}
 		default:
 		case FAULTED: {
 			setMagnetOutput(false);
 			setMotorOutput(HALT);
+			clearGoRequests();
+			if(captureReady()) {
+				dumpCapture();
+			}
+			if(!Fault_Latched) {
+				startRecovery();
+			}
 			break;
 		}
 	}
 }
 
+void markBootPhase(boot_phase_t phase) {
+	Boot_Times[phase] = micros();
+	return;
+}
+
+void reportBoot() {
+	Serial.print(F("BOOT (us):"));
+	for(byte Phase = 0; Phase < BOOT_PHASES; Phase++) {
+		Serial.print(F(" "));
+		Serial.print((const __FlashStringHelper *) BOOT_PHASE_NAMES[Phase]);
+		Serial.print(F(" "));
+		Serial.print(Boot_Times[Phase]);
+	}
+	Serial.print(F("\n"));
+	Boot_Report_Time = micros();
+	return;
+}
+
 void initInputs() {
 	pinMode(GO_PIN, INPUT_PULLUP);
 	pinMode(FORW_PIN, INPUT_PULLUP);
@@ -172,6 +334,227 @@ void initInputs() {
 	return;
 }
 
+void changeState(state_t state) {
+	if((state != Current_State) && (state == CAPTURE_TRIGGER_STATE)) {
+		triggerCapture(CAPTURE_STATE);
+	}
+	Current_State = state;
+	return;
+}
+
+void startSequence(motor_speed_t speed_limit) {
+	Sequence_Speed_Limit = speed_limit;
+	Sequence_Index = 0;
+	startSegment();
+	return;
+}
+
+void startSegment() {
+	State_Start = millis();
+
+	// Return home after the last waypoint
+	if(Sequence_Index >= SEQUENCE_LENGTH) {
+		setMotorSpeed((SEQUENCE_HOME_SPEED < Sequence_Speed_Limit) ? SEQUENCE_HOME_SPEED : Sequence_Speed_Limit);
+		setMotorOutput(BACKWARD);
+		changeState(UP);
+		return;
+	}
+
+	memcpy_P(&Segment, &SEQUENCE[Sequence_Index], sizeof(waypoint_t));
+	Segment.position = constrain(Segment.position, 0L, MOTOR_MAX_MOVEMENT);
+	Segment_Movement = ((Segment.position > getEncoderPos()) ? FORWARD : BACKWARD);
+	setMotorSpeed((Segment.speed < Sequence_Speed_Limit) ? Segment.speed : Sequence_Speed_Limit);
+	setMotorOutput(Segment_Movement);
+	changeState(DOWN);
+	return;
+}
+
+void startRecovery() {
+	unsigned long Now = millis();
+
+	// Count recent faults, including this one
+	byte Attempt = 1;
+	for(byte Fault = 0; Fault < Fault_Count; Fault++) {
+		if((Now - Fault_Times[Fault]) < FAULT_WINDOW) {
+			Attempt += 1;
+		}
+	}
+	if(Attempt > FAULT_BUDGET) {
+		Fault_Latched = true;
+		recordRecovery(Attempt, 0, RECOVERY_LATCHED);
+		Serial.print(F("HARD FAULT ("));
+		Serial.print(Attempt);
+		Serial.print(F(" FAULTS)\n\n"));
+		return;
+	}
+	Fault_Times[Fault_Ptr] = Now;
+	if(++Fault_Ptr >= FAULT_BUDGET) {
+		Fault_Ptr = 0;
+	}
+	if(Fault_Count < FAULT_BUDGET) {
+		Fault_Count += 1;
+	}
+
+	// Move away from the direction the motor was moving when it faulted
+	switch(Faulted_State) {
+		case DOWN:
+			Recovery_Movement = ((Segment_Movement == FORWARD) ? BACKWARD : FORWARD);
+			Recovery_Retry = true;
+			break;
+		case GRAB:
+		case UP:
+			Recovery_Movement = FORWARD;
+			Recovery_Retry = true;
+			break;
+		case RECOVER:
+			if((Recovery_Phase == REVERSE) && (Recovery_Movement == FORWARD)) {
+				Recovery_Movement = BACKWARD;
+			}
+			else {
+				Recovery_Movement = FORWARD;
+			}
+			break;
+		default:
+			Recovery_Movement = FORWARD;
+			Recovery_Retry = false;
+			break;
+	}
+	Recovery_Delay = ((unsigned long) RECOVERY_BACKOFF_DELAY << (Attempt - 1));
+	recordRecovery(Attempt, Recovery_Delay, RECOVERY_PENDING);
+
+	Serial.print(F("RECOVERY "));
+	Serial.print(Attempt);
+	Serial.print(F(" FROM STATE "));
+	Serial.print(Faulted_State);
+	Serial.print(F(" @ POS: "));
+	Serial.print(getEncoderPos());
+	Serial.print(F(" (WAIT "));
+	Serial.print(Recovery_Delay);
+	Serial.print(F(")\n"));
+
+	clearFaultFlag();
+	Recovery_Phase = BACKOFF;
+	State_Start = Now;
+	changeState(RECOVER);
+	return;
+}
+
+void recordRecovery(byte attempt, unsigned long delay, recovery_outcome_t outcome) {
+	endRecovery(RECOVERY_FAULTED);
+	recovery_record_t *Record = &Recovery_Records[Recovery_Record_Ptr];
+	Record->time = millis();
+	Record->position = getEncoderPos();
+	Record->delay = delay;
+	Record->attempt = attempt;
+	Record->state = Faulted_State;
+	Record->outcome = outcome;
+	if(++Recovery_Record_Ptr >= RECOVERY_RECORDS) {
+		Recovery_Record_Ptr = 0;
+	}
+	if(Recovery_Record_Count < RECOVERY_RECORDS) {
+		Recovery_Record_Count += 1;
+	}
+	if(Recovery_Total < 0xFFFF) {
+		Recovery_Total += 1;
+	}
+	return;
+}
+
+void endRecovery(recovery_outcome_t outcome) {
+	if(Recovery_Record_Count == 0) {
+		return;
+	}
+	recovery_record_t *Record = &Recovery_Records[(Recovery_Record_Ptr + RECOVERY_RECORDS - 1) % RECOVERY_RECORDS];
+	if(Record->outcome == RECOVERY_PENDING) {
+		Record->outcome = outcome;
+	}
+	return;
+}
+
+void printRecoveries() {
+	Serial.print(F("RECOVERIES x"));
+	Serial.print(Recovery_Total);
+	Serial.print(F("\n"));
+	byte Index = ((Recovery_Record_Ptr + RECOVERY_RECORDS - Recovery_Record_Count) % RECOVERY_RECORDS);
+	for(byte Record = 0; Record < Recovery_Record_Count; Record++) {
+		Serial.print(F("RECOVERY "));
+		Serial.print(Recovery_Records[Index].attempt);
+		Serial.print(F(" FROM STATE "));
+		Serial.print(Recovery_Records[Index].state);
+		Serial.print(F(" AT: "));
+		Serial.print(Recovery_Records[Index].time);
+		Serial.print(F(" @ POS: "));
+		Serial.print(Recovery_Records[Index].position);
+		Serial.print(F(" WAIT: "));
+		Serial.print(Recovery_Records[Index].delay);
+		Serial.print(F(" "));
+		Serial.print((const __FlashStringHelper *) RECOVERY_OUTCOME_NAMES[Recovery_Records[Index].outcome]);
+		Serial.print(F("\n"));
+		if(++Index >= RECOVERY_RECORDS) {
+			Index = 0;
+		}
+	}
+	Serial.print(F("\n"));
+	return;
+}
+
+void clearFaultHistory() {
+	Fault_Count = 0;
+	Fault_Ptr = 0;
+	Fault_Latched = false;
+	Recovery_Retry = false;
+	return;
+}
+
+void clearGoRequests() {
+	Go_Requests = 0;
+	Go_Back_To_Back = false;
+	return;
+}
+
+void handleSerialInput() {
+	if(Serial.available() <= 0) {
+		return;
+	}
+	switch(Serial.read()) {
+		case 'E':
+		case 'e':
+			printErrors();
+			break;
+		case 'I':
+		case 'i':
+			printEncoderIntegrity();
+			break;
+		case 'R':
+		case 'r':
+			printRecoveries();
+			break;
+		default:
+			break;
+	}
+	return;
+}
+
+byte updateSensors() {
+	byte Sensor_Mask = 0;
+	for(byte Sensor = 0; Sensor <= GRAB_LOAD; Sensor++) {
+		if(sensorEngagedCurrent((sensor_t) Sensor)) {
+			if(++Sensor_Count[Sensor] >= SENSOR_REQUIRED_COUNT) {
+				Sensor_Engaged[Sensor] = true;
+				Sensor_Count[Sensor] -= 1;
+			}
+		}
+		else {
+			Sensor_Engaged[Sensor] = false;
+			Sensor_Count[Sensor] = 0;
+		}
+		if(Sensor_Engaged[Sensor]) {
+			Sensor_Mask |= (1 << Sensor);
+		}
+	}
+	return Sensor_Mask;
+}
+
 bool sensorEngagedCurrent(sensor_t sensor) {
 	bool Value;
 	switch(sensor){
@@ -185,6 +568,8 @@ bool sensorEngagedCurrent(sensor_t sensor) {
 			Value = digitalRead(ENDSTOP_0_PIN);
 			digitalWrite(ENDSTOP_0_LED_PIN, !Value);
 			return(Value);
+		case GRAB_LOAD:
+			return(GRAB_SENSE_ENABLED && (getAnalogValue(ANALOG_GRAB) >= GRAB_LOAD_THRESHOLD));
 		default:
 			return false;
 	}
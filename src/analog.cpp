@@ -0,0 +1,66 @@
+#include "analog.h"
+
+volatile uint16_t Analog_Value[ANALOG_CHANNELS];
+volatile byte Analog_Channel = 0;     // Channel currently being converted
+uint16_t Analog_Sum = 0;
+byte Analog_Samples = 0;
+bool Analog_Discard = true;           // Discard the next conversion
+
+void initAnalog() {
+	for(byte Channel = 0; Channel < ANALOG_CHANNELS; Channel++) {
+		Analog_Value[Channel] = 0;
+	}
+	Analog_Channel = 0;
+
+	// Disable digital input buffers on analog channels
+	DIDR0 |= ((1 << GRAB_SENSE_CHANNEL) | (1 << SUPPLY_SENSE_CHANNEL));
+
+	// Start free-running conversions referenced to AVcc, with a /128 prescaler
+	ADMUX = ((1 << REFS0) | getAnalogMux((analog_channel_t) Analog_Channel));
+	ADCSRB = 0;
+	ADCSRA = ((1 << ADEN) | (1 << ADSC) | (1 << ADATE) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0));
+	return;
+}
+
+uint16_t getAnalogValue(analog_channel_t channel) {
+	noInterrupts();
+	uint16_t Return_Value = Analog_Value[channel];
+	interrupts();
+	return Return_Value;
+}
+
+byte getAnalogMux(analog_channel_t channel) {
+	switch(channel) {
+		case ANALOG_SUPPLY:
+			return SUPPLY_SENSE_CHANNEL;
+		default:
+		case ANALOG_GRAB:
+			return GRAB_SENSE_CHANNEL;
+	}
+}
+
+ISR(ADC_vect) {
+	uint16_t Conversion = ADC;
+	if(Analog_Discard) {
+		Analog_Discard = false;
+		return;
+	}
+
+	Analog_Sum += Conversion;
+	if(++Analog_Samples < ANALOG_AVERAGE_SAMPLES) {
+		return;
+	}
+	Analog_Value[Analog_Channel] = (Analog_Sum >> ANALOG_AVERAGE_SHIFT);
+	Analog_Sum = 0;
+	Analog_Samples = 0;
+
+	// Move on to the next channel
+	if(ANALOG_CHANNELS > 1) {
+		if(++Analog_Channel >= ANALOG_CHANNELS) {
+			Analog_Channel = 0;
+		}
+		ADMUX = ((1 << REFS0) | getAnalogMux((analog_channel_t) Analog_Channel));
+		Analog_Discard = true;
+	}
+	return;
+}
@@ -0,0 +1,85 @@
+/* Analog Sensing Module
+ *
+ * Used to continuously sample analog inputs in the background
+ *
+ * The ADC runs in free-running mode, and each conversion is handled by the ADC interrupt.
+ * Conversions are summed and averaged over ANALOG_AVERAGE_SAMPLES before being published.
+ * When more than one channel is sampled, the channels are cycled through after each average.
+ * The multiplexer is switched while a conversion is already in progress, so the first
+ * conversion after switching still belongs to the previous channel and is discarded.
+ *
+ * With a prescaler of 128, the ADC converts at roughly 9.6 kHz, so each channel is updated
+ * roughly every 1.8 ms for each channel sampled. The ADC interrupt delays the encoder interrupts,
+ * so the ADC is only started if a feature that uses it is enabled.
+ */
+
+#ifndef analog_h
+#define analog_h
+#include <arduino.h>
+
+/////////////////////////
+// CONFIGURATION VARIABLES
+/////////////////////////
+
+// Number of conversions averaged per reading (must be a power of 2, at most 64)
+const byte ANALOG_AVERAGE_SAMPLES = 16;
+const byte ANALOG_AVERAGE_SHIFT = 4;
+
+
+/////////////////////////
+// PIN DEFINITIONS
+/////////////////////////
+
+const byte GRAB_SENSE_CHANNEL = 0;    // A0
+const byte SUPPLY_SENSE_CHANNEL = 1;  // A1, through a divider
+
+
+/////////////////////////
+// ENUMERATIONS
+/////////////////////////
+
+typedef enum {
+	ANALOG_GRAB,
+	ANALOG_SUPPLY
+} analog_channel_t;
+
+#define ANALOG_CHANNELS 2
+
+
+/////////////////////////
+// AVAILABLE FUNCTIONS
+/////////////////////////
+
+void initAnalog();
+/*
+ * Configures the ADC and starts free-running conversions
+ * Must be called once at startup, if any analog channel is used
+ * Until then, every channel reads 0
+ *
+ * Affects ADC registers ADMUX, ADCSRA, ADCSRB, DIDR0
+ */
+
+uint16_t getAnalogValue(analog_channel_t channel);
+/*
+ * Gets the latest averaged reading of an analog channel
+ *
+ * INPUT:  Analog channel
+ * OUTPUT: Averaged reading (0-1023)
+ */
+
+
+/////////////////////////
+// INTERNAL FUNCTIONS
+/////////////////////////
+
+byte getAnalogMux(analog_channel_t channel);
+/*
+ * Gets the ADC multiplexer input for an analog channel
+ * Used by initAnalog() and the ADC interrupt
+ *
+ * INPUT:  Analog channel
+ * OUTPUT: ADC multiplexer input
+ */
+
+
+#endif
@@ -0,0 +1,135 @@
+#include "capture.h"
+
+capture_sample_t Capture_Buffer[CAPTURE_SAMPLES];
+volatile byte Capture_Head = 0;                // Index of the next sample to write
+volatile byte Capture_Count = 0;               // Number of valid samples in the buffer
+volatile byte Capture_Post_Count = 0;          // Samples remaining after the trigger
+volatile byte Capture_Divider_Count = 0;
+volatile byte Capture_Sensors = 0;
+volatile capture_status_t Capture_Status = CAPTURE_ARMED;
+capture_trigger_t Capture_Trigger = CAPTURE_STATE;
+int32_t Capture_Base_Pos = 0;                  // Position preceding the oldest sample
+int32_t Capture_Last_Pos = 0;                  // Position of the newest sample
+
+void initCapture() {
+	Capture_Head = 0;
+	Capture_Count = 0;
+	Capture_Base_Pos = getEncoderPos();
+	Capture_Last_Pos = Capture_Base_Pos;
+	Capture_Status = CAPTURE_ARMED;
+
+	// Enable Timer0 compare A interrupt, halfway through each millis() overflow
+	OCR0A = 0x80;
+	TIMSK0 |= (1 << OCIE0A);
+	return;
+}
+
+void setCaptureSensors(byte sensors) {
+	Capture_Sensors = sensors;
+	return;
+}
+
+void triggerCapture(capture_trigger_t trigger) {
+	if((Capture_Status != CAPTURE_ARMED) || !(CAPTURE_TRIGGERS & (1 << trigger))) {
+		return;
+	}
+	Capture_Trigger = trigger;
+	Capture_Post_Count = CAPTURE_POST_SAMPLES;
+	Capture_Status = CAPTURE_TRIGGERED;
+	return;
+}
+
+bool captureReady() {
+	return (Capture_Status == CAPTURE_DONE);
+}
+
+void dumpCapture() {
+	if(Capture_Status != CAPTURE_DONE) {
+		return;
+	}
+
+	byte Index = ((Capture_Head + CAPTURE_SAMPLES - Capture_Count) % CAPTURE_SAMPLES);
+	byte Trigger_Sample = ((Capture_Count > CAPTURE_POST_SAMPLES) ? (Capture_Count - CAPTURE_POST_SAMPLES) : 0);
+
+	Serial.print(F("CAPTURE "));
+	Serial.print(Capture_Trigger);
+	Serial.print(F(" "));
+	Serial.print(Capture_Count);
+	Serial.print(F(" "));
+	Serial.print(Trigger_Sample);
+	Serial.print(F(" "));
+	Serial.print(1024UL * CAPTURE_DIVIDER);
+	Serial.print(F(" "));
+	Serial.print(Capture_Base_Pos);
+	Serial.print(F("\n"));
+	for(byte Sample = 0; Sample < Capture_Count; Sample++) {
+		Serial.print(Capture_Buffer[Index].delta);
+		Serial.print(F(" "));
+		Serial.print(Capture_Buffer[Index].duty, HEX);
+		Serial.print(F(" "));
+		Serial.print(Capture_Buffer[Index].flags, HEX);
+		Serial.print(F("\n"));
+		if(++Index >= CAPTURE_SAMPLES) {
+			Index = 0;
+		}
+	}
+	Serial.print(F("END\n\n"));
+
+	// Re-arm with an empty buffer, starting from the current position, as the motor may have moved
+	// while sampling was stopped
+	noInterrupts();
+	Capture_Count = 0;
+	Capture_Last_Pos = getEncoderPos();
+	Capture_Base_Pos = Capture_Last_Pos;
+	Capture_Status = CAPTURE_ARMED;
+	interrupts();
+	return;
+}
+
+void takeCaptureSample() {
+	int32_t Current_Pos = getEncoderPos();
+	int32_t Delta = constrain(Current_Pos - Capture_Last_Pos, (int32_t) INT16_MIN, (int32_t) INT16_MAX);
+	Capture_Last_Pos = Current_Pos;
+
+	// Drop the oldest sample into the base position if the buffer is full
+	if(Capture_Count == CAPTURE_SAMPLES) {
+		Capture_Base_Pos += Capture_Buffer[Capture_Head].delta;
+	}
+	else {
+		Capture_Count += 1;
+	}
+
+	// Direction is read directly from PINB, as MOTOR_DIR_PIN is pin 8
+	byte Flags = (Capture_Sensors << CAPTURE_FLAG_SENSORS);
+	if(PINB & 0x01) {
+		Flags |= CAPTURE_FLAG_DIR;
+	}
+	if(magnetEnabled()) {
+		Flags |= CAPTURE_FLAG_MAGNET;
+	}
+
+	Capture_Buffer[Capture_Head].delta = Delta;
+	Capture_Buffer[Capture_Head].duty = ((getMotorDuty() * 255UL) / PWM_TOP);
+	Capture_Buffer[Capture_Head].flags = Flags;
+	if(++Capture_Head >= CAPTURE_SAMPLES) {
+		Capture_Head = 0;
+	}
+
+	if(Capture_Status == CAPTURE_TRIGGERED) {
+		if(--Capture_Post_Count == 0) {
+			Capture_Status = CAPTURE_DONE;
+		}
+	}
+	return;
+}
+
+ISR(TIMER0_COMPA_vect) {
+	if(Capture_Status == CAPTURE_DONE) {
+		return;
+	}
+	if(++Capture_Divider_Count >= CAPTURE_DIVIDER) {
+		Capture_Divider_Count = 0;
+		takeCaptureSample();
+	}
+	return;
+}
@@ -0,0 +1,145 @@
+/* Motion Capture Module
+ *
+ * Used to record a short, high-rate history of motor movement for later analysis
+ *
+ * Samples of encoder position, motor duty cycle, motor direction, magnet state, and sensor
+ * states are continuously recorded into a ring buffer. When a trigger event occurs, recording
+ * continues for CAPTURE_POST_SAMPLES more samples and then stops, leaving a snapshot of the
+ * movement both before and after the event. The snapshot may then be dumped over serial.
+ *
+ * The Timer0 compare A interrupt is used to take samples. Timer0 is already running for
+ * millis(), so this interrupt fires at roughly 976 Hz without changing Timer0 configuration.
+ * Every CAPTURE_DIVIDER interrupts, one sample is taken.
+ *
+ * Encoder position is stored as a change from the previous sample, keeping each sample small.
+ * Motor duty cycle is scaled to 0-255 regardless of PWM resolution.
+ * The dump uses the same format:
+ *
+ *   CAPTURE <trigger> <samples> <trigger sample> <sample period (us)> <start position>
+ *   <position delta> <motor duty (hex)> <flags (hex)>
+ *   ...
+ *   END
+ */
+
+#ifndef capture_h
+#define capture_h
+#include <arduino.h>
+#include "safety-encoder.h"
+#include "power.h"
+
+/////////////////////////
+// CONFIGURATION VARIABLES
+/////////////////////////
+
+// Number of samples stored in the ring buffer (4 bytes of RAM each, at most 255)
+#define CAPTURE_SAMPLES 128
+
+// Number of samples recorded after a trigger; the remainder of the buffer holds pre-trigger samples
+const byte CAPTURE_POST_SAMPLES = 96;
+
+// Number of Timer0 compare interrupts (~1.024 ms each) per sample
+const byte CAPTURE_DIVIDER = 2;
+
+// Trigger events that are allowed to end a capture, one bit each (see capture_trigger_t)
+// The state trigger (bit 0) fires every cycle, and its capture would hide any fault later in the
+// cycle until it is dumped, so only the watchdog, overshoot and undershoot triggers are enabled
+const byte CAPTURE_TRIGGERS = 0x0E;
+
+
+/////////////////////////
+// ENUMERATIONS
+/////////////////////////
+
+typedef enum {
+	CAPTURE_STATE,      // A configured state change in the main state machine
+	CAPTURE_WATCHDOG,   // A motor/encoder watchdog fault
+	CAPTURE_OVERSHOOT,  // The bucket overshot its home position
+	CAPTURE_UNDERSHOOT  // The endstop engaged early
+} capture_trigger_t;
+
+typedef enum {
+	CAPTURE_ARMED,
+	CAPTURE_TRIGGERED,
+	CAPTURE_DONE
+} capture_status_t;
+
+// Sample flag bits; sensor states occupy the bits above CAPTURE_FLAG_SENSORS
+const byte CAPTURE_FLAG_DIR = 0x01;
+const byte CAPTURE_FLAG_MAGNET = 0x02;
+const byte CAPTURE_FLAG_SENSORS = 2;
+
+
+/////////////////////////
+// DATA STRUCTURES
+/////////////////////////
+
+typedef struct {
+	int16_t delta;
+	uint8_t duty;
+	uint8_t flags;
+} capture_sample_t;
+
+
+/////////////////////////
+// AVAILABLE FUNCTIONS
+/////////////////////////
+
+void initCapture();
+/*
+ * Initializes and arms motion capture
+ * Must be called once at startup
+ *
+ * Affects Capture_Status, timer register OCR0A and TIMSK0
+ */
+
+void setCaptureSensors(byte sensors);
+/*
+ * Updates the sensor states recorded in each sample
+ * Should be called whenever the debounced sensor states are updated
+ *
+ * Affects Capture_Sensors
+ * INPUT:  Bitmask of engaged sensors
+ */
+
+void triggerCapture(capture_trigger_t trigger);
+/*
+ * Triggers the capture, if armed and the trigger is enabled in CAPTURE_TRIGGERS
+ * Safe to use within interrupts
+ *
+ * Only the first trigger after arming is recorded.
+ *
+ * Affects Capture_Status, Capture_Trigger, Capture_Post_Count
+ * INPUT:  Trigger event
+ */
+
+bool captureReady();
+/*
+ * Returns true if a completed capture is waiting to be dumped
+ *
+ * OUTPUT: State of being ready
+ */
+
+void dumpCapture();
+/*
+ * Prints the completed capture over serial and re-arms capturing
+ * This blocks while serial output is written, so it should only be used while the motor is idle
+ *
+ * Affects Capture_Status, Capture_Count, Capture_Base_Pos, Capture_Last_Pos
+ */
+
+
+/////////////////////////
+// INTERNAL FUNCTIONS
+/////////////////////////
+
+void takeCaptureSample();
+/*
+ * Records a single sample into the ring buffer
+ * Used by the Timer0 compare A interrupt
+ *
+ * Affects Capture_Buffer[], Capture_Head, Capture_Count, Capture_Base_Pos, Capture_Last_Pos,
+ * Capture_Post_Count, Capture_Status
+ */
+
+
+#endif
@@ -4,7 +4,18 @@ motor_speed_t Motor_Speed = SLOW;
 motor_movement_t Motor_Movement = HALT;
 bool Motor_Enabled = false;
 bool Magnet_Enabled = false;
-unsigned long Magnet_Count = 0;
+bool Relay_Backward = false;
+bool Motor_Ever_Enabled = false;  // Before the motor is first enabled, there is nothing to discharge
+volatile bool Magnet_Pulsing = false;
+volatile uint16_t Magnet_Count = 0;
+
+// Actual and target output compare values, slewed by the Timer1 overflow interrupt
+volatile uint16_t Motor_Duty = 0;
+volatile uint16_t Motor_Target = 0;
+volatile uint16_t Magnet_Duty = 0;
+volatile uint16_t Magnet_Target = 0;
+
+bool Supply_Low = false;
 
 unsigned long Last_Relay_Change = 0;
 unsigned long Last_Motor_Disable = 0;
@@ -12,9 +23,15 @@ unsigned long Last_Motor_Disable = 0;
 
 void initPowerOutputs() {
 
-	// Configure and enable Timer1 unit
-	TCCR1A = ((1 << COM1A1) | (1 << COM1B1) | (1 << WGM10));
-	TCCR1B = (1 << CS12);
+	// Configure and enable Timer1 unit in phase and frequency correct PWM mode, TOP = ICR1
+	TCCR1B = 0;
+	noInterrupts();
+	ICR1 = PWM_TOP;
+	OCR1A = 0;
+	OCR1B = 0;
+	interrupts();
+	TCCR1A = ((1 << COM1A1) | (1 << COM1B1));
+	TCCR1B = ((1 << WGM13) | PWM_PRESCALER_BITS);
 
 	// Set pins as outputs
 	pinMode(MOTOR_DIR_PIN, OUTPUT);
@@ -24,67 +41,80 @@ void initPowerOutputs() {
 
 void setMagnetOutput(bool enable) {
 	Magnet_Enabled = enable;
-	if(Magnet_Enabled) {
-		OCR1BL = PWM_MAGNET_PULSE;
-		Magnet_Count = 0;
-		enablePulseCounter();
-	}
-	else {
-		disablePulseCounter();
-		OCR1BL = 0;
-	}
+	noInterrupts();
+	Magnet_Count = 0;
+	Magnet_Pulsing = Magnet_Enabled;
+	interrupts();
+	setMagnetDuty(Magnet_Enabled ? PWM_MAGNET_PULSE : 0);
 }
 
 void setMotorOutput(motor_movement_t movement) {
 
 	// Skip if no change needed
-	if(Motor_Movement == movement) {
+	if((Motor_Movement == movement) && ((movement != HALT) || !Relay_Backward)) {
 		return;
 	}
 
 	switch(movement) {
 		case FORWARD: {
 			if(Motor_Movement == BACKWARD) {
-				OCR1AL = 0;
+				setMotorDuty(0);
 				disableWatchdog();
 				Last_Motor_Disable = millis();
-				delay(MOTOR_FLYBACK_DELAY);
+			}
+			if(Relay_Backward) {
+				while(Motor_Ever_Enabled && ((millis() - Last_Motor_Disable) < MOTOR_FLYBACK_DELAY)) {
+					// Let the motor discharge
+				}
 				digitalWrite(MOTOR_DIR_PIN, LOW);
+				Relay_Backward = false;
 				Last_Relay_Change = millis();
 			}
 			while((millis() - Last_Relay_Change) < MOTOR_RELAY_CHANGE_DELAY) {
 				// Let the relay settle
 			}
-			OCR1AL = ((Motor_Speed == SLOW) ? PWM_SPEED_SLOW : PWM_SPEED_FAST);
+			setMotorDuty(getSpeedDuty(Motor_Speed));
 			enableWatchdog();
 			Motor_Enabled = true;
+			Motor_Ever_Enabled = true;
 			break;
 		}
 		case BACKWARD: {
 			if(Motor_Movement == FORWARD) {
-				OCR1AL = 0;
+				setMotorDuty(0);
 				disableWatchdog();
 				Last_Motor_Disable = millis();
 			}
-			while((millis() - Last_Motor_Disable) < MOTOR_FLYBACK_DELAY) {
-				// Let the motor discharge
+			if(!Relay_Backward) {
+				while(Motor_Ever_Enabled && ((millis() - Last_Motor_Disable) < MOTOR_FLYBACK_DELAY)) {
+					// Let the motor discharge
+				}
+				digitalWrite(MOTOR_DIR_PIN, HIGH);
+				Relay_Backward = true;
+				Last_Relay_Change = millis();
 			}
-			digitalWrite(MOTOR_DIR_PIN, HIGH);
-			Last_Relay_Change = millis();
-			delay(MOTOR_RELAY_CHANGE_DELAY);
-			OCR1AL = ((Motor_Speed == SLOW) ? PWM_SPEED_SLOW : PWM_SPEED_FAST);
+			while((millis() - Last_Relay_Change) < MOTOR_RELAY_CHANGE_DELAY) {
+				// Let the relay settle
+			}
+			setMotorDuty(getSpeedDuty(Motor_Speed));
 			enableWatchdog();
 			Motor_Enabled = true;
+			Motor_Ever_Enabled = true;
 			break;
 		}
 		default:
 		case HALT: {
-			OCR1AL = 0;
+			setMotorDuty(0);
 			disableWatchdog();
-			Last_Motor_Disable = millis();
-			if(Motor_Movement == BACKWARD) {
-				delay(MOTOR_FLYBACK_DELAY);
+			if(Motor_Enabled) {
+				Last_Motor_Disable = millis();
+			}
+			if(Relay_Backward) {
+				while(Motor_Ever_Enabled && ((millis() - Last_Motor_Disable) < MOTOR_FLYBACK_DELAY)) {
+					// Let the motor discharge
+				}
 				digitalWrite(MOTOR_DIR_PIN, LOW);
+				Relay_Backward = false;
 				Last_Relay_Change = millis();
 			}
 			Motor_Enabled = false;
@@ -95,32 +125,210 @@ void setMotorOutput(motor_movement_t movement) {
 	return;
 }
 
+void stopMotorOutput() {
+	setMotorDuty(0);
+	disableWatchdog();
+	if(Motor_Enabled) {
+		Last_Motor_Disable = millis();
+	}
+	Motor_Enabled = false;
+	Motor_Movement = HALT;
+	return;
+}
+
+void prepareMotorOutput(motor_movement_t movement) {
+	if(Motor_Enabled || (movement == HALT)) {
+		return;
+	}
+	bool Backward = (movement == BACKWARD);
+	if(Backward != Relay_Backward) {
+		digitalWrite(MOTOR_DIR_PIN, (Backward ? HIGH : LOW));
+		Relay_Backward = Backward;
+		Last_Relay_Change = millis();
+	}
+	return;
+}
+
+bool motorOutputReady() {
+	unsigned long Now = millis();
+	return (((Now - Last_Relay_Change) >= MOTOR_RELAY_CHANGE_DELAY) && (!Motor_Ever_Enabled || ((Now - Last_Motor_Disable) >= MOTOR_FLYBACK_DELAY)));
+}
+
 void setMotorSpeed(motor_speed_t speed) {
 	Motor_Speed = speed;
 	if(Motor_Enabled) {
-		OCR1AL = ((Motor_Speed == SLOW) ? PWM_SPEED_SLOW : PWM_SPEED_FAST);
+		setMotorDuty(getSpeedDuty(Motor_Speed));
+	}
+	return;
+}
+
+uint16_t getSpeedDuty(motor_speed_t speed) {
+	switch(speed) {
+		case FAST:
+			return compensateDuty(PWM_SPEED_FAST);
+		case MEDIUM:
+			return compensateDuty(PWM_SPEED_MEDIUM);
+		default:
+		case SLOW:
+			return compensateDuty(PWM_SPEED_SLOW);
+	}
+}
+
+uint16_t compensateDuty(uint16_t duty) {
+	if(!SUPPLY_SENSE_ENABLED) {
+		return duty;
+	}
+	uint16_t Supply = getSupplyVoltage();
+	if(Supply < SUPPLY_MIN_VALID_MV) {
+		return duty;
+	}
+	uint32_t Compensated_Duty = (((uint32_t) duty * SUPPLY_NOMINAL_MV) / Supply);
+	return ((Compensated_Duty > PWM_TOP) ? PWM_TOP : Compensated_Duty);
+}
+
+void handleSupplyVoltage() {
+	if(!SUPPLY_SENSE_ENABLED) {
+		return;
+	}
+	uint16_t Supply = getSupplyVoltage();
+
+	// Warn of a low supply once each time it drops
+	if(!Supply_Low && (Supply >= SUPPLY_MIN_VALID_MV) && (Supply < SUPPLY_LOW_MV)) {
+		Supply_Low = true;
+		flagError(5);
+		Serial.print(F("LOW SUPPLY: "));
+		Serial.print(Supply);
+		Serial.print(F(" mV\n"));
+	}
+	else if(Supply_Low && (Supply >= (SUPPLY_LOW_MV + SUPPLY_LOW_HYSTERESIS_MV))) {
+		Supply_Low = false;
+	}
+
+	// Follow the supply voltage while moving
+	if(Motor_Enabled) {
+		uint16_t Duty = getSpeedDuty(Motor_Speed);
+		if(Duty != Motor_Target) {
+			setMotorDuty(Duty);
+		}
 	}
 	return;
 }
 
+uint16_t getSupplyVoltage() {
+	return (((uint32_t) getAnalogValue(ANALOG_SUPPLY) * SUPPLY_FULL_SCALE_MV) >> 10);
+}
+
+void haltPowerOutputs() {
+
+	// Disconnect both PWM pins from Timer1 and drive them low
+	TIMSK1 = 0;
+	TCCR1A = 0;
+	digitalWrite(MOTOR_PWM_PIN, LOW);
+	digitalWrite(MAGNET_PWM_PIN, LOW);
+	OCR1A = 0;
+	OCR1B = 0;
+	return;
+}
+
 bool motorEnabled() {
 	return Motor_Enabled;
 }
 
-void enablePulseCounter() {
+bool magnetEnabled() {
+	return Magnet_Enabled;
+}
+
+uint16_t getMotorDuty() {
+	uint8_t Old_SREG = SREG;
+	noInterrupts();
+	uint16_t Return_Value = Motor_Duty;
+	SREG = Old_SREG;
+	return Return_Value;
+}
+
+bool motorDutySettled() {
+	noInterrupts();
+	bool Return_Value = (Motor_Duty == Motor_Target);
+	interrupts();
+	return Return_Value;
+}
+
+bool magnetDutySettled() {
+	noInterrupts();
+	bool Return_Value = ((Magnet_Duty == Magnet_Target) && !Magnet_Pulsing);
+	interrupts();
+	return Return_Value;
+}
+
+void setMotorDuty(uint16_t duty) {
+	uint8_t Old_SREG = SREG;
+	noInterrupts();
+	Motor_Target = duty;
+	if((duty == 0) || (PWM_MOTOR_SLEW == 0)) {
+		Motor_Duty = duty;
+		OCR1A = duty;
+	}
+	else {
+		enableOverflowInterrupt();
+	}
+	SREG = Old_SREG;
+	return;
+}
+
+void setMagnetDuty(uint16_t duty) {
+	noInterrupts();
+	Magnet_Target = duty;
+	if((duty == 0) || (PWM_MAGNET_SLEW == 0)) {
+		Magnet_Duty = duty;
+		OCR1B = duty;
+	}
+	if(Magnet_Pulsing || (Magnet_Duty != Magnet_Target)) {
+		enableOverflowInterrupt();
+	}
+	interrupts();
+	return;
+}
+
+uint16_t slewDuty(uint16_t duty, uint16_t target, uint16_t step) {
+	if((step == 0) || (duty == target)) {
+		return target;
+	}
+	if(duty < target) {
+		return (((target - duty) > step) ? (duty + step) : target);
+	}
+	return (((duty - target) > step) ? (duty - step) : target);
+}
+
+void enableOverflowInterrupt() {
 	TIMSK1 = (1 << TOIE1);
 	return;
 }
 
-void disablePulseCounter() {
+void disableOverflowInterrupt() {
 	TIMSK1 = 0;
 	return;
 }
 
 ISR(TIMER1_OVF_vect) {
-	if (Magnet_Count++ >= MAGNET_PULSE_LENGTH) {
-		OCR1BL = PWM_MAGNET_HOLD;
-		disablePulseCounter();
+
+	// Handle magnet pulse
+	if(Magnet_Pulsing && (Magnet_Count++ >= MAGNET_PULSE_LENGTH)) {
+		Magnet_Pulsing = false;
+		Magnet_Target = PWM_MAGNET_HOLD;
+	}
+
+	// Handle duty cycle slewing
+	if(Motor_Duty != Motor_Target) {
+		Motor_Duty = slewDuty(Motor_Duty, Motor_Target, PWM_MOTOR_SLEW);
+		OCR1A = Motor_Duty;
+	}
+	if(Magnet_Duty != Magnet_Target) {
+		Magnet_Duty = slewDuty(Magnet_Duty, Magnet_Target, PWM_MAGNET_SLEW);
+		OCR1B = Magnet_Duty;
+	}
+
+	if(!Magnet_Pulsing && (Motor_Duty == Motor_Target) && (Magnet_Duty == Magnet_Target)) {
+		disableOverflowInterrupt();
 	}
 	return;
 }
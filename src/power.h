@@ -6,13 +6,28 @@
  *
  * The motor is automatically disabled for a short while before and after switching directions.
  * This may block code from running temporarily.
+ * To avoid blocking, the direction relay may be switched ahead of time with prepareMotorOutput().
  *
  * The electromagnet automatically outputs at a higher duty cycle for a short while when enabled.
  * This is referred to as the "pulse".
  *
- * The Timer1 unit is used to control the two power outputs in phase-correct PWM mode,
- * running at about 122 Hz. In addition, the overflow interrupt is used to time the magnet
- * pulse length. This interrupt is disabled when the pulse length has already been met.
+ * The Timer1 unit is used to control the two power outputs in phase and frequency correct PWM mode,
+ * using ICR1 as TOP. This allows for an inaudible PWM frequency (20 kHz by default), with a duty
+ * resolution of PWM_TOP + 1 steps. Both outputs share Timer1 and therefore the same frequency.
+ * Output compare values are double-buffered by the hardware and take effect at BOTTOM, so
+ * duty cycle changes never produce a glitched PWM period. 16-bit output compare registers
+ * share a temporary register, so they are only written with interrupts disabled.
+ *
+ * Motor duty cycle presets are defined for a supply of SUPPLY_NOMINAL_MV. If supply sensing is
+ * enabled, the motor supply is sampled in the background by the Analog Sensing Module and each
+ * preset is scaled to apply the same average voltage to the motor at any supply voltage.
+ * A preset of PWM_TOP can only be scaled down. A low supply voltage also flags error 5.
+ *
+ * In addition, the overflow interrupt is used to time the magnet pulse length, which is
+ * configured in milliseconds independent of the PWM frequency, and to slew the duty cycle of
+ * each output toward its target by a limited step every PWM period. This limits inrush current
+ * when the motor starts. Disabling an output is never slewed. The overflow interrupt is disabled
+ * when the pulse length has already been met and both outputs have reached their targets.
  *
  * Written by Ana Tavares <tavaresa13@gmail.com>
  */
@@ -21,18 +36,57 @@
 #define power_h
 #include <arduino.h>
 #include "safety.h"
+#include "analog.h"
 
 /////////////////////////
 // CONFIGURATION VARIABLES
 /////////////////////////
 
-const byte MAGNET_PULSE_LENGTH = 15;  // Number of timer1 cycles (~122 Hz)
+// PWM frequency and Timer1 clock
+// PWM_PRESCALER is the Timer1 clock divisor: 1, 8, 64, 256, or 1024.
+// Lower frequencies give higher duty resolution; 122 Hz with a prescaler of 256 gives 8 bits.
+const unsigned long PWM_FREQUENCY = 20000;
+const unsigned int PWM_PRESCALER = 1;
+const uint16_t PWM_TOP = (F_CPU / (2UL * PWM_PRESCALER * PWM_FREQUENCY));
+
+// Timer1 clock select bits (CS12:CS10) for PWM_PRESCALER
+const byte PWM_PRESCALER_BITS =
+	(PWM_PRESCALER == 1) ? (1 << CS10) :
+	(PWM_PRESCALER == 8) ? (1 << CS11) :
+	(PWM_PRESCALER == 64) ? ((1 << CS11) | (1 << CS10)) :
+	(PWM_PRESCALER == 256) ? (1 << CS12) :
+	(PWM_PRESCALER == 1024) ? ((1 << CS12) | (1 << CS10)) : 0;
+static_assert(PWM_PRESCALER_BITS != 0, "PWM_PRESCALER must be 1, 8, 64, 256, or 1024");
+
+const unsigned int MAGNET_PULSE_TIME = 123;  // Milliseconds
+const uint16_t MAGNET_PULSE_LENGTH = ((PWM_FREQUENCY * MAGNET_PULSE_TIME) / 1000);  // Number of Timer1 cycles
+
+// Maximum duty cycle change per PWM period, as output compare values (0 disables slewing)
+// At 20 kHz, a step of 1 ramps the motor from off to PWM_TOP in 20 ms.
+const uint16_t PWM_MOTOR_SLEW = 1;
+const uint16_t PWM_MAGNET_SLEW = 0;
 
-// PWM presets
-const uint8_t PWM_SPEED_SLOW = 75;
-const uint8_t PWM_SPEED_FAST = 255;
-const uint8_t PWM_MAGNET_PULSE = 255;
-const uint8_t PWM_MAGNET_HOLD = 100;
+// PWM presets, as output compare values out of PWM_TOP
+const uint16_t PWM_SPEED_SLOW = ((PWM_TOP * 75UL) / 255);
+const uint16_t PWM_SPEED_MEDIUM = ((PWM_TOP * 160UL) / 255);
+const uint16_t PWM_SPEED_FAST = PWM_TOP;
+const uint16_t PWM_MAGNET_PULSE = PWM_TOP;
+const uint16_t PWM_MAGNET_HOLD = ((PWM_TOP * 100UL) / 255);
+
+// Supply voltage sensing
+// SUPPLY_FULL_SCALE_MV is the supply voltage that reads as full scale through the divider.
+// Readings below SUPPLY_MIN_VALID_MV are treated as a missing divider and ignored.
+// The host tests enable it by defining SUPPLY_SENSE when building.
+#ifdef SUPPLY_SENSE
+const bool SUPPLY_SENSE_ENABLED = true;
+#else
+const bool SUPPLY_SENSE_ENABLED = false;
+#endif
+const unsigned long SUPPLY_FULL_SCALE_MV = 25000;
+const uint16_t SUPPLY_NOMINAL_MV = 12000;
+const uint16_t SUPPLY_MIN_VALID_MV = 3000;
+const uint16_t SUPPLY_LOW_MV = 10500;
+const uint16_t SUPPLY_LOW_HYSTERESIS_MV = 500;
 
 // Motor state delays
 const unsigned int MOTOR_FLYBACK_DELAY = 100;
@@ -54,6 +108,7 @@ const byte MAGNET_PWM_PIN = 10;
 
 typedef enum {
 	SLOW,
+	MEDIUM,
 	FAST
 } motor_speed_t;
 
@@ -89,10 +144,39 @@ void setMotorOutput(motor_movement_t movement);
 /*
  * Sets the motor output type
  *
- * Affects Motor_Enabled
+ * Affects Motor_Enabled, Motor_Ever_Enabled, Relay_Backward
  * INPUT:  Type of movement
  */
 
+void stopMotorOutput();
+/*
+ * Disables the motor immediately, without blocking
+ * Safe to use within interrupts
+ *
+ * The direction relay is left as is. A later setMotorOutput(HALT) returns it to forward once the
+ * motor has discharged.
+ *
+ * Affects Motor_Enabled, Motor_Movement, Last_Motor_Disable
+ */
+
+void prepareMotorOutput(motor_movement_t movement);
+/*
+ * Switches the direction relay for a movement ahead of time, without enabling the motor
+ * Has no effect while the motor is enabled
+ *
+ * Once motorOutputReady() returns true, setMotorOutput() will not block for this movement.
+ *
+ * Affects Relay_Backward, Last_Relay_Change
+ * INPUT:  Type of movement to prepare for
+ */
+
+bool motorOutputReady();
+/*
+ * Returns true if the relay has settled and the motor has discharged
+ *
+ * OUTPUT: State of being ready
+ */
+
 void setMotorSpeed(motor_speed_t speed);
 /*
  * Sets the speed of the motor
@@ -101,6 +185,29 @@ void setMotorSpeed(motor_speed_t speed);
  * INPUT:  Motor speed
  */
 
+void handleSupplyVoltage();
+/*
+ * Updates the motor duty cycle to follow the supply voltage and checks for a low supply
+ * Must be placed within a loop that executes regularly
+ *
+ * Affects Supply_Low, Motor_Target, Error_Mask, Error_Records[4]
+ */
+
+uint16_t getSupplyVoltage();
+/*
+ * Gets the latest averaged motor supply voltage
+ *
+ * OUTPUT: Supply voltage, in millivolts
+ */
+
+void haltPowerOutputs();
+/*
+ * Immediately disables both power outputs, without any delays
+ * Safe to use within interrupts; intended only for use before a reset
+ *
+ * Affects timer registers TCCR1A, TIMSK1, OCR1A, OCR1B
+ */
+
 bool motorEnabled();
 /*
  * Gets the state of the motor
@@ -108,33 +215,99 @@ bool motorEnabled();
  * OUTPUT: State of being enabled
  */
 
+bool magnetEnabled();
+/*
+ * Gets the state of the electromagnet
+ *
+ * OUTPUT: State of being enabled
+ */
+
+uint16_t getMotorDuty();
+/*
+ * Gets the current motor output compare value
+ * Safe to use within interrupts, as the interrupt state is restored afterward
+ *
+ * OUTPUT: Motor duty cycle, out of PWM_TOP
+ */
+
+bool motorDutySettled();
+/*
+ * Returns true if the motor duty cycle has finished slewing to its target
+ *
+ * OUTPUT: State of being settled
+ */
+
+bool magnetDutySettled();
+/*
+ * Returns true if the magnet pulse has completed and its duty cycle has finished slewing
+ *
+ * OUTPUT: State of being settled
+ */
+
 
 /////////////////////////
 // INTERNAL FUNCTIONS
 /////////////////////////
 
-void enablePulseCounter();
+uint16_t getSpeedDuty(motor_speed_t speed);
 /*
- * Enables the Timer1 overflow interrupt
- * Used when the magnet is enabled by setMagnetOutput()
+ * Gets the duty cycle preset for a motor speed, compensated for the supply voltage
  *
- * This interrupt is used to count cycles for the electromagnet pulse.
- * It will reduce the duty cycle of the magnet when the pulse completes.
+ * INPUT:  Motor speed
+ * OUTPUT: Motor duty cycle, out of PWM_TOP
+ */
+
+void setMotorDuty(uint16_t duty);
+/*
+ * Sets the motor duty cycle target
+ * Off is applied immediately; other values are slewed by the Timer1 overflow interrupt
+ * Safe to use within interrupts, as the interrupt state is restored afterward
  *
- * This function should be called when enabling the electromagnet.
+ * Affects Motor_Target, Motor_Duty, timer registers OCR1A and TIMSK1
+ * INPUT:  Motor duty cycle, out of PWM_TOP
+ */
+
+void setMagnetDuty(uint16_t duty);
+/*
+ * Sets the magnet duty cycle target
+ * Off is applied immediately; other values are slewed by the Timer1 overflow interrupt
  *
- * Affects timer register TIMSK1
+ * Affects Magnet_Target, Magnet_Duty, timer registers OCR1B and TIMSK1
+ * INPUT:  Magnet duty cycle, out of PWM_TOP
  */
 
-void disablePulseCounter();
+uint16_t compensateDuty(uint16_t duty);
 /*
- * Disables the Timer1 overflow interrupt
+ * Scales a duty cycle preset for the current supply voltage
+ * Used by getSpeedDuty()
+ *
+ * If supply sensing is disabled or the supply reading is not valid, the preset is unchanged.
+ *
+ * INPUT:  Duty cycle at SUPPLY_NOMINAL_MV, out of PWM_TOP
+ * OUTPUT: Duty cycle at the current supply voltage, out of PWM_TOP
+ */
+
+uint16_t slewDuty(uint16_t duty, uint16_t target, uint16_t step);
+/*
+ * Moves a duty cycle toward its target by at most one step
  * Used by the Timer1 overflow interrupt
  *
- * This interrupt is used to count cycles for the electromagnet pulse.
- * If disabled, the electromagnet pulse will not terminate.
+ * INPUT:  Current duty cycle, target duty cycle, maximum step (0 for no limit)
+ * OUTPUT: New duty cycle
+ */
+
+void enableOverflowInterrupt();
+/*
+ * Enables the Timer1 overflow interrupt
+ * Used when the magnet pulse starts or a duty cycle needs slewing
  *
- * This function should be called when disabling the electromagnet.
+ * Affects timer register TIMSK1
+ */
+
+void disableOverflowInterrupt();
+/*
+ * Disables the Timer1 overflow interrupt
+ * Used by the Timer1 overflow interrupt once the magnet pulse and all slewing are complete
  *
  * Affects timer register TIMSK1
  */
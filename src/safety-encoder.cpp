@@ -1,6 +1,7 @@
 #include "safety-encoder.h"
 
 encoder_data_t Encoder_Data;
+unsigned long Encoder_Init_Time = 0;
 
 void initEncoder() {
 
@@ -10,7 +11,21 @@ void initEncoder() {
 
   // Set starting state
   Encoder_Data.position = 0;
-  delayMicroseconds(2000);
+  Encoder_Data.skipped_int0 = 0;
+  Encoder_Data.skipped_int1 = 0;
+  Encoder_Init_Time = micros();
+
+  return;
+}
+
+bool encoderSettled() {
+  return ((micros() - Encoder_Init_Time) >= ENCODER_SETTLE_TIME);
+}
+
+void startEncoder() {
+  while(!encoderSettled()) {
+    // Let the pullups settle
+  }
   Encoder_Data.state = ((PIND & (0b00001100)) >> 2);
 
   // Enable Ext pin interrupts
@@ -21,12 +36,17 @@ void initEncoder() {
 }
 
 int32_t getEncoderPos() {
+  uint8_t Old_SREG = SREG;
   noInterrupts();
   int32_t Return_Value = Encoder_Data.position;
-  interrupts();
+  SREG = Old_SREG;
   return Return_Value;
 }
 
+byte getEncoderSkipped(byte interrupt) {
+  return ((interrupt == 0) ? Encoder_Data.skipped_int0 : Encoder_Data.skipped_int1);
+}
+
 void homeEncoder() {
   noInterrupts();
   Encoder_Data.position = 0;
@@ -81,7 +101,7 @@ ISR(INT0_vect) {
     "sbci r23, 0"    "\n\t"
     "sbci r24, 0"    "\n\t"
     "sbci r25, 0"    "\n\t"
-    "rjmp L%=store"  "\n\t"
+    "rjmp L%=skip"   "\n\t"
   "L%=minus1:"       "\n\t"
     "subi r22, 1"    "\n\t"
     "sbci r23, 0"    "\n\t"
@@ -90,10 +110,23 @@ ISR(INT0_vect) {
     "rjmp L%=store"  "\n\t"
   "L%=plus2:"        "\n\t"
     "subi r22, 254"  "\n\t"
-    "rjmp L%=z"      "\n\t"
+    "sbci r23, 255"  "\n\t"
+    "sbci r24, 255"  "\n\t"
+    "sbci r25, 255"  "\n\t"
+
+    // Both pins changed, so an edge was missed; store and count it
+  "L%=skip:"         "\n\t"
+    "st -X, r25"     "\n\t"
+    "st -X, r24"     "\n\t"
+    "st -X, r23"     "\n\t"
+    "st -X, r22"     "\n\t"
+    "movw r30, r26"  "\n\t"
+    "ldd r22, Z+%[skip]" "\n\t"
+    "inc r22"        "\n\t"
+    "std Z+%[skip], r22" "\n\t"
+    "rjmp L%=end"    "\n\t"
   "L%=plus1:"        "\n\t"
     "subi r22, 255"  "\n\t"
-  "L%=z:"            "\n\t"
     "sbci r23, 255"  "\n\t"
     "sbci r24, 255"  "\n\t"
     "sbci r25, 255"  "\n\t"
@@ -106,7 +139,8 @@ ISR(INT0_vect) {
   :
   : "x" (&Encoder_Data),
     [pind] "I" (_SFR_IO_ADDR(PIND)),
-    [mask] "I" (0b00001100)
+    [mask] "I" (0b00001100),
+    [skip] "I" (offsetof(encoder_data_t, skipped_int0) - offsetof(encoder_data_t, position))
   : "r22",
     "r23",
     "r24",
@@ -164,7 +198,7 @@ ISR(INT1_vect) {
     "sbci r23, 0"    "\n\t"
     "sbci r24, 0"    "\n\t"
     "sbci r25, 0"    "\n\t"
-    "rjmp L%=store"  "\n\t"
+    "rjmp L%=skip"   "\n\t"
   "L%=minus1:"       "\n\t"
     "subi r22, 1"    "\n\t"
     "sbci r23, 0"    "\n\t"
@@ -173,10 +207,23 @@ ISR(INT1_vect) {
     "rjmp L%=store"  "\n\t"
   "L%=plus2:"        "\n\t"
     "subi r22, 254"  "\n\t"
-    "rjmp L%=z"      "\n\t"
+    "sbci r23, 255"  "\n\t"
+    "sbci r24, 255"  "\n\t"
+    "sbci r25, 255"  "\n\t"
+
+    // Both pins changed, so an edge was missed; store and count it
+  "L%=skip:"         "\n\t"
+    "st -X, r25"     "\n\t"
+    "st -X, r24"     "\n\t"
+    "st -X, r23"     "\n\t"
+    "st -X, r22"     "\n\t"
+    "movw r30, r26"  "\n\t"
+    "ldd r22, Z+%[skip]" "\n\t"
+    "inc r22"        "\n\t"
+    "std Z+%[skip], r22" "\n\t"
+    "rjmp L%=end"    "\n\t"
   "L%=plus1:"        "\n\t"
     "subi r22, 255"  "\n\t"
-  "L%=z:"            "\n\t"
     "sbci r23, 255"  "\n\t"
     "sbci r24, 255"  "\n\t"
     "sbci r25, 255"  "\n\t"
@@ -189,7 +236,8 @@ ISR(INT1_vect) {
   :
   : "x" (&Encoder_Data),
     [pind] "I" (_SFR_IO_ADDR(PIND)),
-    [mask] "I" (0b00001100)
+    [mask] "I" (0b00001100),
+    [skip] "I" (offsetof(encoder_data_t, skipped_int1) - offsetof(encoder_data_t, position))
   : "r22",
     "r23",
     "r24",
@@ -42,6 +42,11 @@
  *  1     1     1     0     +1      +1
  *  1     1     1     1     0       0
  *
+ * Transitions where both pins changed at once (0011, 0110, 1001, 1100) are only possible if an
+ * edge was missed, usually because interrupts were disabled for too long. These are still counted
+ * as +/-2, but are also tallied separately for each interrupt so that the Safety Module can
+ * monitor how often edges are being missed. The tallies are 8 bits and wrap around.
+ *
  * Based on Paul Stoffregen's Encoder library <http://www.pjrc.com/teensy/td_libs_Encoder.html>
  * Written by Ana Tavares <tavaresa13@gmail.com>
  */
@@ -49,6 +54,15 @@
 #ifndef safety_encoder_h
 #define safety_encoder_h
 #include <arduino.h>
+#include <stddef.h>
+
+/////////////////////////
+// CONFIGURATION VARIABLES
+/////////////////////////
+
+// Time allowed for the encoder pullups to settle before the initial pin states are read
+const unsigned int ENCODER_SETTLE_TIME = 2000;  // Microseconds
+
 
 /////////////////////////
 // PIN DEFINITIONS
@@ -62,9 +76,12 @@ const byte ENC_B_PIN = 3;
 // DATA STRUCTURES
 /////////////////////////
 
+// The interrupt routines depend on this layout
 typedef struct {
   uint8_t state;
   int32_t position;
+  uint8_t skipped_int0;
+  uint8_t skipped_int1;
 } encoder_data_t;
 
 /////////////////////////
@@ -73,10 +90,29 @@ typedef struct {
 
 void initEncoder();
 /*
- * Initializes encoder tracking
- * Should be called before using motor functions
+ * Configures the encoder pins
+ * Should be called as early as possible at startup
+ *
+ * The pins are given ENCODER_SETTLE_TIME to settle before startEncoder() reads them, so other
+ * startup work may be done in the meantime.
  *
- * Initialization involves pin and interrupt configuration, and determining initial pin states.
+ * Affects Encoder_Data, Encoder_Init_Time
+ */
+
+bool encoderSettled();
+/*
+ * Checks whether the encoder pins have had ENCODER_SETTLE_TIME to settle since initEncoder()
+ *
+ * OUTPUT: Whether startEncoder() can start without waiting
+ */
+
+void startEncoder();
+/*
+ * Starts encoder tracking
+ * Must be called after initEncoder(), and before using motor functions
+ *
+ * Waits for any remaining settling time, then determines initial pin states and enables the
+ * pin interrupts. Startup may instead carry on until encoderSettled().
  *
  * Affects Encoder_Data
  */
@@ -84,10 +120,20 @@ void initEncoder();
 int32_t getEncoderPos();
 /*
  * Returns the current absolute position of the encoder
+ * Safe to use within interrupts, as the interrupt state is restored afterward
  *
  * OUTPUT: Encoder position
  */
 
+byte getEncoderSkipped(byte interrupt);
+/*
+ * Returns the number of missed-edge transitions seen by an encoder interrupt
+ * The count wraps around after 255
+ *
+ * INPUT:  Interrupt number (0 or 1)
+ * OUTPUT: Missed-edge transitions
+ */
+
 void homeEncoder();
 /*
  * Sets the current encoder position to "0"
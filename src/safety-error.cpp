@@ -1,12 +1,19 @@
 #include "safety-error.h"
 
-bool Error_Status[ERROR_CODES];
+volatile uint16_t Error_Mask = 0;    // Bit (n - 1) is set if error n is active
+error_record_t Error_Records[ERROR_CODES];
 unsigned long Error_Tick_Start = 0;
 byte Error_Tick_Curr = 0;            // Current tick within the cycle (0-indexed)
-byte Error_Cycle_Blinks = 0;         // Number of blinks in the current cycle (1-indexed)
+byte Error_Cycle_Code = 0;           // Error code of the current cycle (1-indexed)
+byte Error_Cycle_Digits[ERROR_DIGITS];
+byte Error_Cycle_Digit_Count = 0;
+byte Error_Cycle_Ticks = ERROR_DIGIT_TICKS + ERROR_CODE_GAP_TICKS;
 
 void initErrors() {
 	clearErrors();
+	for(byte Error = 0; Error < ERROR_CODES; Error++) {
+		Error_Records[Error].count = 0;
+	}
 	pinMode(ERROR_PIN, OUTPUT);
 	return;
 }
@@ -16,11 +23,14 @@ void handleErrorCodeDisplay() {
 
 	if(Tick_Elapsed_Time >= ERROR_TICK_TIME) {
 		Error_Tick_Curr += 1;
-		if(Error_Tick_Curr == ERROR_CODES) {
+		if(Error_Tick_Curr >= Error_Cycle_Ticks) {
 			Error_Tick_Curr = 0;
-			Error_Cycle_Blinks = getBlinksNext(Error_Cycle_Blinks);
+			Error_Cycle_Code = getBlinksNext(Error_Cycle_Code);
+			Error_Cycle_Digit_Count = getBlinkDigits(Error_Cycle_Code, Error_Cycle_Digits);
+			Error_Cycle_Ticks = (max(Error_Cycle_Digit_Count, 1) * ERROR_DIGIT_TICKS) + ERROR_CODE_GAP_TICKS;
 		}
-		if(Error_Tick_Curr < Error_Cycle_Blinks) {
+		byte Digit = Error_Tick_Curr / ERROR_DIGIT_TICKS;
+		if((Digit < Error_Cycle_Digit_Count) && ((Error_Tick_Curr % ERROR_DIGIT_TICKS) < Error_Cycle_Digits[Digit])) {
 			digitalWrite(ERROR_PIN, HIGH);
 		}
 		Error_Tick_Start = millis();
@@ -35,31 +45,83 @@ void flagError(byte error) {
 	if((error == 0) || (error > ERROR_CODES)) {
 		return;
 	}
-	Error_Status[error - 1] = true;
+	unsigned long Now = millis();
+	int32_t Position = getEncoderPos();
+	error_record_t *Record = &Error_Records[error - 1];
+
+	uint8_t Old_SREG = SREG;
+	noInterrupts();
+	Error_Mask |= (1 << (error - 1));
+	if(Record->count == 0) {
+		Record->first_time = Now;
+	}
+	if(Record->count < 0xFFFF) {
+		Record->count += 1;
+	}
+	Record->last_time = Now;
+	Record->last_position = Position;
+	SREG = Old_SREG;
 	return;
 }
 
 void clearErrors() {
+	Error_Mask = 0;
+	return;
+}
+
+void printErrors() {
 	for(byte Error = 0; Error < ERROR_CODES; Error++) {
-		Error_Status[Error] = false;
+		noInterrupts();
+		error_record_t Record = Error_Records[Error];
+		bool Active = (Error_Mask & (1 << Error));
+		interrupts();
+		if(Record.count == 0) {
+			continue;
+		}
+		Serial.print(F("ERROR "));
+		Serial.print(Error + 1);
+		if(Active) {
+			Serial.print(F(" ACTIVE"));
+		}
+		else {
+			Serial.print(F(" CLEARED"));
+		}
+		Serial.print(F(" x"));
+		Serial.print(Record.count);
+		Serial.print(F(" FIRST: "));
+		Serial.print(Record.first_time);
+		Serial.print(F(" LAST: "));
+		Serial.print(Record.last_time);
+		Serial.print(F(" @ POS: "));
+		Serial.print(Record.last_position);
+		Serial.print(F("\n"));
 	}
+	Serial.print(F("\n"));
 	return;
 }
 
 byte getBlinksNext(byte blinks_prev) {
-	if(blinks_prev < ERROR_CODES) {
-		for(byte Blinks_Test = (blinks_prev + 1); Blinks_Test <= ERROR_CODES; Blinks_Test++) {
-			if(Error_Status[Blinks_Test - 1]) {
-				return Blinks_Test;
-			}
-		}
+	uint16_t Mask = Error_Mask;
+	if(Mask == 0) {
+		return 0;
 	}
-	if(blinks_prev > 0) {
-		for(byte Blinks_Test = 1; Blinks_Test <= blinks_prev; Blinks_Test++) {
-			if(Error_Status[Blinks_Test - 1]) {
-				return Blinks_Test;
-			}
-		}
+
+	// Prefer the lowest active error after the previous one, otherwise wrap around
+	uint16_t Mask_After = ((blinks_prev < 16) ? (Mask & (0xFFFF << blinks_prev)) : 0);
+	return (__builtin_ctz(Mask_After ? Mask_After : Mask) + 1);
+}
+
+byte getBlinkDigits(byte error, byte digits[]) {
+	byte Count = 0;
+	byte Remaining = error;
+	byte Reversed[ERROR_DIGITS];
+	while((Remaining > 0) && (Count < ERROR_DIGITS)) {
+		byte Digit = ((Remaining - 1) % ERROR_DIGIT_MAX) + 1;
+		Reversed[Count++] = Digit;
+		Remaining = (Remaining - Digit) / ERROR_DIGIT_MAX;
+	}
+	for(byte Digit = 0; Digit < Count; Digit++) {
+		digits[Digit] = Reversed[Count - 1 - Digit];
 	}
-	return 0;
+	return Count;
 }
@@ -10,18 +10,31 @@
  * Updating of the error code display is not handled automatically. handleErrorCodeDisplay() must
  * be called frequently elsewhere to ensure the status LED is displaying error codes correctly.
  *
- * Each error code is displayed within a "cycle". Each cycle consists of ERROR_CODES "ticks".
+ * Each error code is displayed within a "cycle". A cycle is made up of one or more "digits",
+ * each of which lasts ERROR_DIGIT_TICKS "ticks", followed by ERROR_CODE_GAP_TICKS empty ticks.
  * Each tick lasts for ERROR_TICK_TIME milliseconds. At the beginning of each tick,
  * the LED may or may not turn on to represent a "blink".
  * After ERROR_BLINK_TIME elapses within a tick, the LED will be disabled.
  *
- * The following diagram assumes ERROR_CODES = 3 and the error code 2 is being displayed repeatedly:
+ * Codes up to ERROR_DIGIT_MAX are shown as a single digit of that many blinks. Larger codes are
+ * shown as several digits, each of 1 to ERROR_DIGIT_MAX blinks, read most significant first.
+ * For example, with ERROR_DIGIT_MAX = 4, code 6 is shown as 1 blink followed by 2 blinks
+ * (1 * 4 + 2). No digit is ever shown as 0 blinks.
  *
- * |_________           |_________           |                    |_________           |
- * |         |__________|         |_______________________________|         |__________| and so on...
+ * The following diagram assumes ERROR_DIGIT_TICKS = 3, ERROR_CODE_GAP_TICKS = 1,
+ * and the error code 2 is being displayed repeatedly:
+ *
+ * |_________           |_________                                                         |_____
+ * |         |__________|         |_________________________________________________________|     and so on...
  *  --blink--            --blink--
- *  --------tick-------- --------tick-------- --------tick--------
- * -----------------------------cycle-----------------------------
+ *  --------tick-------- --------tick-------- --------tick-------- --------tick--------
+ * -------------------------digit------------------------------
+ * ----------------------------------------cycle----------------------------------------
+ *
+ * Errors are stored as a bitmask, so the next code to display is found directly from the mask.
+ * Each code also records how many times it has been flagged, when it was first and last flagged,
+ * and the encoder position when last flagged. These records are kept when errors are cleared,
+ * and may be printed over serial with printErrors().
  *
  * Written by Ana Tavares <tavaresa13@gmail.com>
  */
@@ -29,16 +42,35 @@
 #ifndef safety_error_h
 #define safety_error_h
 #include <arduino.h>
+#include "safety-encoder.h"
 
 /////////////////////////
 // CONFIGURATION VARIABLES
 /////////////////////////
 
-#define ERROR_CODES 4
+#define ERROR_CODES 8  // At most 16
 
 const unsigned int ERROR_TICK_TIME = 250;
 const unsigned int ERROR_BLINK_TIME = 100;
 
+// Blink layout
+#define ERROR_DIGITS 2  // Enough digits to show ERROR_CODES
+const byte ERROR_DIGIT_MAX = 4;
+const byte ERROR_DIGIT_TICKS = 5;
+const byte ERROR_CODE_GAP_TICKS = 2;
+
+
+/////////////////////////
+// DATA STRUCTURES
+/////////////////////////
+
+typedef struct {
+	uint16_t count;
+	unsigned long first_time;
+	unsigned long last_time;
+	int32_t last_position;
+} error_record_t;
+
 
 /////////////////////////
 // PIN DEFINITIONS
@@ -58,7 +90,7 @@ void initErrors();
  *
  * Initialization involves setting status variables and pin configuration.
  *
- * Affects Error_Status[]
+ * Affects Error_Mask, Error_Records[]
  */
 
 void handleErrorCodeDisplay();
@@ -66,22 +98,30 @@ void handleErrorCodeDisplay();
  * Updates the status LED to display error codes
  * Must be placed within a loop that executes regularly
  *
- * Affects Error_Tick_Start, Error_Tick_Curr, and Error_Cycle_Blinks
+ * Affects Error_Tick_Start, Error_Tick_Curr, Error_Cycle_Code, Error_Cycle_Digits[],
+ * Error_Cycle_Ticks
  */
 
 void flagError(byte error);
 /*
- * Sets a single error code to true
+ * Sets a single error code to true and records its occurrence
+ * Safe to use within interrupts, as the interrupt state is restored afterward
  *
- * Affects Error_Status[]
+ * Affects Error_Mask, Error_Records[]
  * INPUT:  Error code to set (1-indexed)
  */
 
 void clearErrors();
 /*
  * Clears all error codes
+ * Occurrence records are kept
  *
- * Affects Error_Status[]
+ * Affects Error_Mask
+ */
+
+void printErrors();
+/*
+ * Prints the occurrence record of every error code that has been flagged since startup
  */
 
 
@@ -91,7 +131,7 @@ void clearErrors();
 
 byte getBlinksNext(byte blinks_prev);
 /*
- * Scans through active errors and determines the next one to display
+ * Determines the next active error to display
  * Used by handleErrorCodeDisplay()
  *
  * If no errors are flagged, returns 0.
@@ -100,5 +140,14 @@ byte getBlinksNext(byte blinks_prev);
  * OUTPUT: Next error to display (1-indexed)
  */
 
+byte getBlinkDigits(byte error, byte digits[]);
+/*
+ * Splits an error code into digits for display
+ * Used by handleErrorCodeDisplay()
+ *
+ * INPUT:  Error code (1-indexed), array of ERROR_DIGITS digits to fill (most significant first)
+ * OUTPUT: Number of digits
+ */
+
 
 #endif
@@ -5,6 +5,12 @@ long Watchdog_Queue[WATCHDOG_CYCLES + 1];
 byte Watchdog_Queue_Ptr = 0;
 bool Is_Faulted = false;
 
+byte Skip_Last[2] = {0, 0};
+unsigned long Skip_Total[2] = {0, 0};
+uint16_t Skip_Window_Count = 0;
+byte Skip_Window_Cycle = 0;
+uint16_t Skip_Rate = 0;                // Missed edges in the last full window
+
 void initWatchdog() {
 
 	initEncoder();
@@ -41,17 +47,63 @@ void clearFaults() {
 	return;
 }
 
+void clearFaultFlag() {
+	Is_Faulted = false;
+	return;
+}
+
+void printEncoderIntegrity() {
+	noInterrupts();
+	unsigned long Total_Int0 = Skip_Total[0];
+	unsigned long Total_Int1 = Skip_Total[1];
+	uint16_t Rate = Skip_Rate;
+	interrupts();
+	Serial.print(F("SKIPPED INT0: "));
+	Serial.print(Total_Int0);
+	Serial.print(F(" INT1: "));
+	Serial.print(Total_Int1);
+	Serial.print(F(" RATE: "));
+	Serial.print(Rate);
+	Serial.print(F("\n\n"));
+	return;
+}
+
+void updateSkipRate() {
+	for(byte Interrupt = 0; Interrupt < 2; Interrupt++) {
+		byte Skipped = getEncoderSkipped(Interrupt);
+		byte Skipped_New = Skipped - Skip_Last[Interrupt];
+		Skip_Last[Interrupt] = Skipped;
+		Skip_Total[Interrupt] += Skipped_New;
+		Skip_Window_Count += Skipped_New;
+	}
+	if(++Skip_Window_Cycle >= SKIP_WINDOW_CYCLES) {
+		if((Skip_Window_Count > SKIP_RATE_THRESHOLD) && (Skip_Rate <= SKIP_RATE_THRESHOLD)) {
+			flagError(6);
+		}
+		Skip_Rate = Skip_Window_Count;
+		Skip_Window_Count = 0;
+		Skip_Window_Cycle = 0;
+	}
+	return;
+}
+
 void raiseWatchdogError() {
-	setMotorOutput(HALT);
+	stopMotorOutput();
 	Is_Faulted = true;
 	flagError(3);
+	triggerCapture(CAPTURE_WATCHDOG);
 	return;
 }
 
 ISR(TIMER2_OVF_vect) {
+	checkInSupervisor(HEARTBEAT_TIMER2);
+
 	// Handle error code updating, so main loop doesn't have to worry about it
 	handleErrorCodeDisplay();
 
+	// Handle encoder signal integrity monitoring
+	updateSkipRate();
+
 	// Handle motor/encoder watchdog
 	if(Watchdog_Enabled) {
 		long Current_Encoder_Pos = getEncoderPos();
@@ -61,11 +113,11 @@ ISR(TIMER2_OVF_vect) {
 		}
 		long Prev_Encoder_Pos = Watchdog_Queue[Watchdog_Queue_Ptr];
 		if(abs(Current_Encoder_Pos - Prev_Encoder_Pos) <= WATCHDOG_THRESHOLD) {
-			Serial.print("WATCHDOG ERROR @ ");
+			Serial.print(F("WATCHDOG ERROR @ "));
 			Serial.print(Current_Encoder_Pos);
-			Serial.print(" (");
+			Serial.print(F(" ("));
 			Serial.print(Prev_Encoder_Pos);
-			Serial.print(")\n");
+			Serial.print(F(")\n"));
 			raiseWatchdogError();
 		}
 	}
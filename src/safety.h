@@ -8,6 +8,9 @@
  * It runs at approximately 61 Hz. If the motor is found to not be moving a sufficient amount
  * between interrupts, the motor is haulted and an error is flagged.
  *
+ * The same interrupt also monitors how often the encoder interrupts miss an edge, as a measure of
+ * whether the firmware is keeping up with the encoder.
+ *
  * Written by Ana Tavares <tavaresa13@gmail.com>
  */
 
@@ -17,6 +20,8 @@
 #include "safety-error.h"
 #include "safety-encoder.h"
 #include "power.h"
+#include "capture.h"
+#include "supervisor.h"
 
 /////////////////////////
 // CONFIGURATION VARIABLES
@@ -31,6 +36,12 @@
 // Minimum encoder travel (bidirectional) seen by the watchdog to consider the motor to be moving
 const byte WATCHDOG_THRESHOLD = 100;
 
+// Encoder signal integrity
+// Missed-edge transitions (see safety-encoder.h) are totalled over windows of SKIP_WINDOW_CYCLES
+// watchdog cycles (~1 second). A window with more than SKIP_RATE_THRESHOLD flags error 6.
+const byte SKIP_WINDOW_CYCLES = 61;
+const uint16_t SKIP_RATE_THRESHOLD = 10;
+
 
 /////////////////////////
 // AVAILABLE FUNCTIONS
@@ -40,6 +51,8 @@ void initWatchdog();
 /*
  * Configures and initializes motor watchdog and error codes
  * Should be called before using motor functions
+ *
+ * The encoder is configured but not started; startEncoder() must also be called.
  */
 
 void enableWatchdog();
@@ -67,25 +80,50 @@ bool isFaulted();
 
 void clearFaults();
 /*
- * Removes motor fault flag
+ * Removes motor fault flag and clears all error codes
+ *
+ * Affects Is_Faulted, Error_Mask
+ */
+
+void clearFaultFlag();
+/*
+ * Removes motor fault flag, leaving error codes displayed
+ * Used when recovering from a fault automatically
  *
  * Affects Is_Faulted
  */
 
 
+void printEncoderIntegrity();
+/*
+ * Prints missed-edge totals for each encoder interrupt and the latest missed-edge rate
+ */
+
+
 /////////////////////////
 // INTERNAL FUNCTIONS
 /////////////////////////
 
+void updateSkipRate();
+/*
+ * Tallies missed encoder edges and flags an error if they are too frequent
+ * Used by the Timer2 overflow interrupt
+ *
+ * Affects Skip_Last[], Skip_Total[], Skip_Window_Count, Skip_Window_Cycle, Skip_Rate,
+ * Error_Mask, Error_Records[5]
+ */
+
 void raiseWatchdogError();
 /*
  * Flags the motor as faulted and takes appropriate actions
  * Used by the Timer2 overflow interrupt
  *
  * This includes halting the motor and flagging the appropriate error code for display.
+ * The direction relay is left for the main loop to release, as waiting for the motor to discharge
+ * would block the interrupt.
  *
- * Affects Is_Faulted, Motor_Movement, Last_Motor_Disable, Last_Relay_Change, Motor_Enabled,
- * Error_Status[3]
+ * Affects Is_Faulted, Motor_Movement, Last_Motor_Disable, Motor_Enabled, Error_Mask,
+ * Error_Records[2]
  */
 
 
@@ -0,0 +1,71 @@
+#include "supervisor.h"
+
+byte Supervisor_Reset_Flags __attribute__((section(".noinit")));
+uint16_t Supervisor_Magic __attribute__((section(".noinit")));
+byte Supervisor_Missed __attribute__((section(".noinit")));       // Heartbeats missing at the last timeout
+volatile byte Supervisor_Heartbeats = 0;
+
+void readResetCause() {
+	Supervisor_Reset_Flags = MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+}
+
+void initSupervisor() {
+
+	// Report the cause of the last reset
+	Serial.print(F("RESET:"));
+	if(Supervisor_Reset_Flags & (1 << PORF)) {
+		Serial.print(F(" POWER"));
+	}
+	if(Supervisor_Reset_Flags & (1 << EXTRF)) {
+		Serial.print(F(" EXTERNAL"));
+	}
+	if(Supervisor_Reset_Flags & (1 << BORF)) {
+		Serial.print(F(" BROWNOUT"));
+	}
+	if(Supervisor_Reset_Flags & (1 << WDRF)) {
+		Serial.print(F(" WATCHDOG"));
+	}
+	if((Supervisor_Magic == SUPERVISOR_MAGIC) && !(Supervisor_Reset_Flags & (1 << PORF))) {
+		Serial.print(F(" SUPERVISOR (MISSED "));
+		Serial.print(Supervisor_Missed, HEX);
+		Serial.print(F(")"));
+		flagError(4);
+	}
+	Serial.print(F("\n"));
+	Supervisor_Magic = 0;
+
+	// Start the WDT in interrupt and reset mode
+	Supervisor_Heartbeats = 0;
+	noInterrupts();
+	wdt_reset();
+	WDTCSR = ((1 << WDCE) | (1 << WDE));
+	WDTCSR = ((1 << WDIE) | (1 << WDE) | SUPERVISOR_TIMEOUT);
+	interrupts();
+	return;
+}
+
+void checkInSupervisor(heartbeat_t heartbeat) {
+	uint8_t Old_SREG = SREG;
+	noInterrupts();
+	Supervisor_Heartbeats |= heartbeat;
+	if(Supervisor_Heartbeats == HEARTBEAT_ALL) {
+		Supervisor_Heartbeats = 0;
+		wdt_reset();
+	}
+	SREG = Old_SREG;
+	return;
+}
+
+ISR(WDT_vect) {
+	haltPowerOutputs();
+	Supervisor_Missed = (HEARTBEAT_ALL & ~Supervisor_Heartbeats);
+	Supervisor_Magic = SUPERVISOR_MAGIC;
+
+	// Wait for the second timeout to reset the board, so a recovered heartbeat can't resume
+	// running with the power outputs disconnected
+	while(true) {
+		// Wait for reset
+	}
+}
@@ -0,0 +1,90 @@
+/* Supervisor Module
+ *
+ * Uses the on-chip watchdog timer ("WDT") to reset the board if the firmware stops running
+ *
+ * This is separate from the motor/encoder watchdog in the Safety Module, which detects a jammed
+ * motor. The supervisor instead detects the firmware itself hanging, such as the main loop
+ * getting stuck or interrupts remaining disabled.
+ *
+ * Each supervised part of the firmware checks in with its own "heartbeat". The WDT is only reset
+ * once every heartbeat has checked in since the last reset. If any heartbeat stops, the WDT times
+ * out after roughly SUPERVISOR_TIMEOUT. The WDT runs in interrupt and reset mode; the first
+ * timeout runs the WDT interrupt, which immediately disables both power outputs, records the
+ * missing heartbeats, and then waits with interrupts disabled for the second timeout to reset the
+ * board. If interrupts are disabled, the board is reset directly, which also disables the power
+ * outputs.
+ *
+ * The reset cause is read from MCUSR before setup() runs, and the supervisor record is kept in
+ * uninitialized RAM so it survives the reset. Both are reported over serial at startup, and a
+ * supervisor reset flags error 4. Note that some bootloaders clear MCUSR before the firmware
+ * starts, in which case only supervisor resets are reported reliably.
+ */
+
+#ifndef supervisor_h
+#define supervisor_h
+#include <arduino.h>
+#include <avr/wdt.h>
+#include "power.h"
+#include "safety-error.h"
+
+/////////////////////////
+// CONFIGURATION VARIABLES
+/////////////////////////
+
+// WDT timeout prescaler bits (WDP3:WDP0); 0.5 s covers the longest blocking motor direction change
+const byte SUPERVISOR_TIMEOUT = ((1 << WDP2) | (1 << WDP0));
+
+// Marks the supervisor record in uninitialized RAM as valid
+const uint16_t SUPERVISOR_MAGIC = 0xC0DE;
+
+
+/////////////////////////
+// ENUMERATIONS
+/////////////////////////
+
+typedef enum {
+	HEARTBEAT_LOOP = 0x01,    // Main loop
+	HEARTBEAT_TIMER2 = 0x02   // Timer2 overflow interrupt (interrupts are enabled and running)
+} heartbeat_t;
+
+const byte HEARTBEAT_ALL = (HEARTBEAT_LOOP | HEARTBEAT_TIMER2);
+
+
+/////////////////////////
+// AVAILABLE FUNCTIONS
+/////////////////////////
+
+void initSupervisor();
+/*
+ * Reports the cause of the last reset and starts the WDT
+ * Should be called at the end of setup()
+ *
+ * Affects Supervisor_Magic, WDT register WDTCSR
+ */
+
+void checkInSupervisor(heartbeat_t heartbeat);
+/*
+ * Checks in a heartbeat, resetting the WDT once all heartbeats have checked in
+ * Safe to use within interrupts, as the interrupt state is restored afterward
+ *
+ * Affects Supervisor_Heartbeats
+ * INPUT:  Heartbeat checking in
+ */
+
+
+/////////////////////////
+// INTERNAL FUNCTIONS
+/////////////////////////
+
+void readResetCause() __attribute__((naked, used, section(".init3")));
+/*
+ * Saves MCUSR and disables the WDT before the C runtime initializes
+ * Runs automatically at startup
+ *
+ * A WDT reset leaves the WDT enabled with its shortest timeout, so it must be disabled early.
+ *
+ * Affects Supervisor_Reset_Flags, MCUSR, WDT register WDTCSR
+ */
+
+
+#endif
@@ -0,0 +1,140 @@
+#include "trace.h"
+
+trace_record_t Trace_Buffer[TRACE_RECORDS];
+volatile byte Trace_Head = 0;       // Index of the next record to queue
+volatile byte Trace_Tail = 0;       // Index of the next record to write
+byte Trace_Lost = 0;                // Changes to merge into the next record that fits
+byte Trace_Ticks = 0;
+bool Trace_Tick_Counted = false;    // The pending tick was already counted by a pin change
+byte Trace_Last_Inputs = 0;
+int32_t Trace_Last_Pos = 0;
+
+void initTrace() {
+	if(!TRACE_ENABLED) {
+		return;
+	}
+	Trace_Last_Inputs = getTraceInputs();
+	Trace_Last_Pos = getEncoderPos();
+	Serial.print(F("TRACE 1024 "));
+	Serial.print(Trace_Last_Inputs, HEX);
+	Serial.print(F("\n"));
+
+	// Enable Timer0 compare B interrupt, a quarter of the way through each millis() overflow
+	OCR0B = 0x40;
+	TIMSK0 |= (1 << OCIE0B);
+
+	// Enable pin change interrupts for the buttons (PC2-PC4) and ENDSTOP_0 (PD4)
+	PCMSK1 |= ((1 << PCINT10) | (1 << PCINT11) | (1 << PCINT12));
+	PCMSK2 |= (1 << PCINT20);
+	PCICR |= ((1 << PCIE1) | (1 << PCIE2));
+	return;
+}
+
+void handleTrace() {
+	if(!TRACE_ENABLED) {
+		return;
+	}
+
+	// The record at the tail is not written to by the interrupts until it has been written out
+	while((Trace_Tail != Trace_Head) && (Serial.availableForWrite() >= TRACE_RECORD_LENGTH)) {
+		trace_record_t *Record = &Trace_Buffer[Trace_Tail];
+
+		// The offset of a record holding merged changes is the number of changes merged
+		if(Record->inputs & TRACE_FLAG_LOST) {
+			Serial.print(F("@!"));
+			Serial.print(Record->offset);
+			Serial.print(F("\n@"));
+			Serial.print(Record->ticks);
+		}
+		else {
+			Serial.print(F("@"));
+			Serial.print(Record->ticks);
+			if(Record->offset > 0) {
+				Serial.print(F("+"));
+				Serial.print(Record->offset * 4);
+			}
+		}
+		Serial.print(F(","));
+		Serial.print((byte) (Record->inputs & ~TRACE_FLAG_LOST), HEX);
+		Serial.print(F(","));
+		Serial.print(Record->delta);
+		Serial.print(F("\n"));
+		Trace_Tail = ((Trace_Tail + 1) % TRACE_RECORDS);
+	}
+	return;
+}
+
+byte getTraceInputs() {
+	// ENC_A, ENC_B and ENDSTOP_0 are PD2-PD4; BACK, FORW and GO are PC2-PC4
+	return (((PIND >> 2) & 0x07) | ((PINC << 1) & 0x38));
+}
+
+void queueTraceRecord(byte inputs, byte offset) {
+	int32_t Current_Pos = getEncoderPos();
+
+	// If the buffer is full, this change is merged into the next record that fits
+	byte Next_Head = ((Trace_Head + 1) % TRACE_RECORDS);
+	if(Next_Head == Trace_Tail) {
+		if(Trace_Lost < 255) {
+			Trace_Lost += 1;
+		}
+		return;
+	}
+	Trace_Buffer[Trace_Head].ticks = Trace_Ticks;
+	Trace_Buffer[Trace_Head].offset = offset;
+	Trace_Buffer[Trace_Head].inputs = inputs;
+	Trace_Buffer[Trace_Head].delta = constrain(Current_Pos - Trace_Last_Pos, (int32_t) INT16_MIN, (int32_t) INT16_MAX);
+	if(Trace_Lost > 0) {
+		Trace_Buffer[Trace_Head].offset = Trace_Lost;
+		Trace_Buffer[Trace_Head].inputs |= TRACE_FLAG_LOST;
+		Trace_Lost = 0;
+	}
+	Trace_Head = Next_Head;
+	Trace_Ticks = 0;
+	Trace_Last_Inputs = inputs;
+	Trace_Last_Pos = Current_Pos;
+	return;
+}
+
+void handleTracePinChange() {
+	byte Inputs = getTraceInputs();
+	if(Inputs == Trace_Last_Inputs) {
+		return;
+	}
+
+	// If the tick has passed but its interrupt is still pending, it is counted now instead
+	byte Offset = (TCNT0 - OCR0B);
+	if((TIFR0 & (1 << OCF0B)) && !Trace_Tick_Counted) {
+		Trace_Tick_Counted = true;
+		if(Trace_Ticks < 255) {
+			Trace_Ticks += 1;
+		}
+	}
+	queueTraceRecord(Inputs, Offset);
+	return;
+}
+
+ISR(TIMER0_COMPB_vect) {
+	byte Inputs = getTraceInputs();
+	if(Trace_Tick_Counted) {
+		Trace_Tick_Counted = false;
+	}
+	else if(Trace_Ticks < 255) {
+		Trace_Ticks += 1;
+	}
+	if((Inputs == Trace_Last_Inputs) && (getEncoderPos() == Trace_Last_Pos) && (Trace_Ticks < 255)) {
+		return;
+	}
+	queueTraceRecord(Inputs, 0);
+	return;
+}
+
+ISR(PCINT1_vect) {
+	handleTracePinChange();
+	return;
+}
+
+ISR(PCINT2_vect) {
+	handleTracePinChange();
+	return;
+}
@@ -0,0 +1,131 @@
+/* Input Trace Module
+ *
+ * Used to stream a timestamped record of raw input changes over serial
+ *
+ * This is intended for recording field problems (such as false watchdog faults or noisy buttons)
+ * so that they may be studied and replayed away from the display (see test/replay.cpp).
+ *
+ * The Timer0 compare B interrupt is used to sample the raw input pins. Timer0 is already running
+ * for millis(), so this interrupt fires at roughly 976 Hz; each interrupt is one "tick".
+ * A record is queued whenever an input level or the encoder position changes. The buttons and
+ * ENDSTOP_0 also raise pin change interrupts, which queue a record at once, timed to within 4 us
+ * by the Timer0 count, so that glitches shorter than a tick are recorded with their length.
+ * Records are queued in a small ring buffer and written to serial from handleTrace(), without
+ * blocking, as space in the serial transmit buffer allows.
+ *
+ * Encoder edges are not recorded individually, as they can occur far faster than serial can
+ * write records. They are counted by the Encoder Module, and each record holds the position
+ * change since the previous record, so their timing within a record and any missed edges are
+ * only known from the recorded encoder pin levels.
+ *
+ * Tracing uses most of the serial bandwidth while the motor is moving at FAST speed, and the
+ * pin change interrupts delay the encoder interrupts, so it is disabled unless TRACE_ENABLED is set.
+ *
+ * Each record is written on its own line in the following format:
+ *
+ *   @<ticks since previous record>,<input levels (hex)>,<encoder position change>
+ *   @<ticks since previous record>+<microseconds after the tick>,<input levels (hex)>,<encoder position change>
+ *
+ * The first form is sampled at the tick, and the second is queued by a pin change interrupt
+ * (a pin change at the tick itself uses the first form).
+ * A tick count of 255 with no input or position change is written if nothing changes for 255 ticks.
+ * If the buffer fills up, further changes are merged into the next record that fits, and
+ * "@!<changes merged>" is written just before that record, which is then always written in the
+ * first form. Tick counts saturate at 255 in this case.
+ * Input levels are raw pin states (pullups make an unpressed button read 1):
+ *
+ *   bit   5     4     3     2          1      0
+ *         GO    FORW  BACK  ENDSTOP_0  ENC_B  ENC_A
+ */
+
+#ifndef trace_h
+#define trace_h
+#include <arduino.h>
+#include "safety-encoder.h"
+
+/////////////////////////
+// CONFIGURATION VARIABLES
+/////////////////////////
+
+// The host tests enable tracing by defining TRACE when building
+#ifdef TRACE
+const bool TRACE_ENABLED = true;
+#else
+const bool TRACE_ENABLED = false;
+#endif
+
+// Number of records queued for serial output (5 bytes of RAM each, at most 255)
+#define TRACE_RECORDS 32
+
+// Longest record written, including a preceding "@!" line ("@!255\n@255,3F,-32768\n")
+const byte TRACE_RECORD_LENGTH = 21;
+
+// Flag in the input levels of a queued record, set if changes were merged into the record
+const byte TRACE_FLAG_LOST = 0x80;
+
+
+/////////////////////////
+// DATA STRUCTURES
+/////////////////////////
+
+typedef struct {
+	uint8_t ticks;
+	uint8_t offset;    // Timer0 counts after the tick, or the number of changes merged
+	uint8_t inputs;    // Input levels and flags
+	int16_t delta;
+} trace_record_t;
+
+
+/////////////////////////
+// AVAILABLE FUNCTIONS
+/////////////////////////
+
+void initTrace();
+/*
+ * Initializes input tracing, if TRACE_ENABLED is set
+ * Must be called once at startup, after the encoder is initialized
+ *
+ * Affects Trace_Last_Inputs, Trace_Last_Pos, timer register OCR0B and TIMSK0,
+ * pin change interrupt registers PCMSK1, PCMSK2 and PCICR
+ */
+
+void handleTrace();
+/*
+ * Writes queued trace records to serial without blocking
+ * Must be placed within a loop that executes regularly
+ *
+ * Affects Trace_Tail
+ */
+
+
+/////////////////////////
+// INTERNAL FUNCTIONS
+/////////////////////////
+
+byte getTraceInputs();
+/*
+ * Reads the raw state of all traced inputs
+ * Used by the Timer0 compare B and pin change interrupts
+ *
+ * OUTPUT: Input levels, arranged as described above
+ */
+
+void queueTraceRecord(byte inputs, byte offset);
+/*
+ * Queues a record of the inputs and the encoder position change since the previous record
+ * Used by the Timer0 compare B and pin change interrupts, with interrupts disabled
+ *
+ * Affects Trace_Buffer[], Trace_Head, Trace_Ticks, Trace_Lost, Trace_Last_Inputs, Trace_Last_Pos
+ * INPUT:  Input levels, Timer0 counts (4 us each) after the tick, or 0 if sampled at the tick
+ */
+
+void handleTracePinChange();
+/*
+ * Queues a record if a traced input changed between ticks
+ * Used by the pin change interrupts
+ *
+ * Affects Trace_Ticks, Trace_Tick_Counted, and those affected by queueTraceRecord()
+ */
+
+
+#endif
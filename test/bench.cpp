@@ -0,0 +1,118 @@
+/* Host Benchmarks
+ *
+ * Times the firmware's hot paths on the host, and counts the AVR cycles taken by each path through
+ * the encoder interrupts' assembly.
+ *
+ * Host timings are only useful for comparing changes to the same function, since the host is far
+ * faster than the ATmega 328P and int is wider. Cycle counts of the assembly are exact for the
+ * statement itself; the interrupt entry and exit around it are estimated. The AVR cost of the other
+ * functions timed here is estimated from a firmware build by tools/cost.sh.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "../CML-Firmware.h"
+#include "host-asm.h"
+
+// Interrupt response (4), vector jump (3), the compiler's prologue and epilogue saving SREG, r0,
+// r1 and the 8 registers used by the statement (47), loading X (2), and RETI (4)
+const unsigned long ISR_OVERHEAD_CYCLES = 60;
+
+const unsigned long BENCH_ITERATIONS = 1000000;
+
+extern encoder_data_t Encoder_Data;
+extern bool Watchdog_Enabled;
+
+void setup();
+void loop();
+
+double nowNs() {
+	struct timespec Time;
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return ((Time.tv_sec * 1e9) + Time.tv_nsec);
+}
+
+void bench(const char *name, void (*function)()) {
+	for(unsigned long i = 0; i < (BENCH_ITERATIONS / 10); i++) {
+		function();
+	}
+	double Start = nowNs();
+	for(unsigned long i = 0; i < BENCH_ITERATIONS; i++) {
+		function();
+	}
+	printf("%-32s %8.1f ns\n", name, (nowNs() - Start) / BENCH_ITERATIONS);
+	return;
+}
+
+void benchUpdateSensors() {
+	updateSensors();
+}
+
+void benchGetBlinksNext() {
+	static byte Blinks = 0;
+	Blinks = getBlinksNext(Blinks);
+}
+
+void benchErrorDisplay() {
+	mockAdvance(1000);
+	handleErrorCodeDisplay();
+}
+
+void benchTimer2() {
+	Encoder_Data.position += 1000;
+	mockInterrupt(TIMER2_OVF_vect);
+}
+
+void benchTimer1() {
+	setMotorDuty(PWM_TOP);
+	mockInterrupt(TIMER1_OVF_vect);
+	setMotorDuty(0);
+}
+
+void benchGetEncoderPos() {
+	getEncoderPos();
+}
+
+void benchLoop() {
+	loop();
+}
+
+// Counts the AVR cycles of an encoder interrupt for one transition
+void benchEncoder(byte interrupt, byte from, byte to, const char *name) {
+	mockSetPin(ENC_A_PIN, (from & 0b01) ? HIGH : LOW);
+	mockSetPin(ENC_B_PIN, (from & 0b10) ? HIGH : LOW);
+	Encoder_Data.state = from;
+	mockSetPin(ENC_A_PIN, (to & 0b01) ? HIGH : LOW);
+	mockSetPin(ENC_B_PIN, (to & 0b10) ? HIGH : LOW);
+	mockInterrupt((interrupt == 0) ? INT0_vect : INT1_vect);
+	unsigned long Cycles = getHostAsmCycles() + ISR_OVERHEAD_CYCLES;
+	printf("INT%d %-22s %6lu %8lu %8lu %10.0f\n", interrupt, name, getHostAsmInstructions(), getHostAsmCycles(), Cycles, (F_CPU / (double) Cycles));
+	return;
+}
+
+int main() {
+	setup();
+	flagError(1);
+	flagError(3);
+	Watchdog_Enabled = true;
+
+	printf("HOST                                 TIME\n");
+	bench("updateSensors()", benchUpdateSensors);
+	bench("getBlinksNext()", benchGetBlinksNext);
+	bench("handleErrorCodeDisplay()", benchErrorDisplay);
+	bench("TIMER2_OVF_vect", benchTimer2);
+	bench("TIMER1_OVF_vect (slewing)", benchTimer1);
+	bench("getEncoderPos()", benchGetEncoderPos);
+	bench("loop() (idle)", benchLoop);
+
+	printf("\nAVR                           INSNS   CYCLES    TOTAL  UPDATES/S\n");
+	for(byte Interrupt = 0; Interrupt < 2; Interrupt++) {
+		benchEncoder(Interrupt, 0b00, 0b00, "no change");
+		benchEncoder(Interrupt, 0b00, 0b10, "+1");
+		benchEncoder(Interrupt, 0b00, 0b01, "-1");
+		benchEncoder(Interrupt, 0b00, 0b11, "+/-2 (missed edge)");
+	}
+	printf("\nTOTAL includes an estimated %lu cycles of interrupt entry and exit\n", ISR_OVERHEAD_CYCLES);
+	printf("See tools/cost.sh for the AVR cycles of the other functions\n");
+	return 0;
+}
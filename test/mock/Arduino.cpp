@@ -0,0 +1,383 @@
+#include <stdio.h>
+#include <vector>
+#include "Arduino.h"
+#include "avr/wdt.h"
+
+volatile uint8_t SREG = (1 << SREG_I);
+volatile uint8_t MCUSR = 0;
+volatile uint8_t WDTCSR = 0;
+volatile uint8_t EICRA = 0;
+volatile uint8_t EIMSK = 0;
+volatile uint8_t OCR0A = 0;
+volatile uint8_t OCR0B = 0;
+volatile uint8_t TIMSK0 = 0;
+volatile uint8_t TIFR0 = 0;
+volatile uint8_t PCICR = 0;
+volatile uint8_t PCMSK1 = 0;
+volatile uint8_t PCMSK2 = 0;
+volatile uint8_t TCCR1A = 0;
+volatile uint8_t TCCR1B = 0;
+volatile uint16_t ICR1 = 0;
+volatile uint16_t OCR1A = 0;
+volatile uint16_t OCR1B = 0;
+volatile uint8_t TIMSK1 = 0;
+volatile uint8_t TCCR2B = 0;
+volatile uint8_t TIMSK2 = 0;
+volatile uint8_t ADMUX = 0;
+volatile uint8_t ADCSRA = 0;
+volatile uint8_t ADCSRB = 0;
+volatile uint8_t DIDR0 = 0;
+volatile uint16_t ADC = 0;
+
+unsigned long Mock_Wdt_Resets = 0;
+bool Mock_Wdt_Enabled = false;
+
+MockSerial Serial;
+
+uint8_t Mock_Pin_Mode[NUM_DIGITAL_PINS];
+uint8_t Mock_Pin_Input[NUM_DIGITAL_PINS];
+uint8_t Mock_Pin_Output[NUM_DIGITAL_PINS];
+std::vector<mock_pin_write_t> Mock_Pin_Writes;
+unsigned long Mock_Micros = 0;
+unsigned long Mock_Stall_Count = 0;
+bool Mock_Timers_Running = false;
+unsigned long Mock_Timer_Next[3];  // Time each timer's next interrupt is due, or Timer0's next count
+unsigned long Mock_Timer0_Start = 0;
+unsigned long Mock_Adc_Next = 0;   // Time the ADC conversion in progress ends
+uint8_t Mock_Adc_Channel = 0;      // Channel of the ADC conversion in progress
+uint16_t Mock_Analog[MOCK_ANALOG_CHANNELS];
+
+
+/////////////////////////
+// SERIAL
+/////////////////////////
+
+MockSerial::MockSerial() {
+	write_space = 63;
+}
+
+void MockSerial::begin(unsigned long baud) {
+	(void) baud;
+	return;
+}
+
+int MockSerial::available() {
+	return input.size();
+}
+
+int MockSerial::read() {
+	if(input.empty()) {
+		return -1;
+	}
+	int Character = (unsigned char) input[0];
+	input.erase(0, 1);
+	return Character;
+}
+
+int MockSerial::availableForWrite() {
+	return write_space;
+}
+
+void MockSerial::print(const __FlashStringHelper *text) {
+	append(reinterpret_cast<const char *>(text));
+	return;
+}
+
+void MockSerial::print(const char *text) {
+	append(text);
+	return;
+}
+
+void MockSerial::print(char character) {
+	char Text[2] = {character, '\0'};
+	append(Text);
+	return;
+}
+
+void MockSerial::print(unsigned char number, int base) {
+	printNumber(number, base, false);
+	return;
+}
+
+void MockSerial::print(int number, int base) {
+	print((long) number, base);
+	return;
+}
+
+void MockSerial::print(unsigned int number, int base) {
+	printNumber(number, base, false);
+	return;
+}
+
+void MockSerial::print(long number, int base) {
+	// As in the Arduino core, only decimal numbers are printed with a sign
+	if((base == DEC) && (number < 0)) {
+		printNumber(-(unsigned long) number, base, true);
+	}
+	else {
+		printNumber((unsigned long) number, base, false);
+	}
+	return;
+}
+
+void MockSerial::print(unsigned long number, int base) {
+	printNumber(number, base, false);
+	return;
+}
+
+void MockSerial::printNumber(unsigned long number, int base, bool negative) {
+	char Text[72];
+	char *Digit = &Text[sizeof(Text) - 1];
+	*Digit = '\0';
+	do {
+		unsigned long Value = number % base;
+		*--Digit = ((Value < 10) ? ('0' + Value) : ('A' + Value - 10));
+		number /= base;
+	} while(number > 0);
+	if(negative) {
+		*--Digit = '-';
+	}
+	append(Digit);
+	return;
+}
+
+void MockSerial::append(const char *text) {
+	for(; *text != '\0'; text++) {
+		output += *text;
+		if(*text == '\n') {
+			line_times.push_back(Mock_Micros);
+		}
+	}
+	return;
+}
+
+
+/////////////////////////
+// CORE FUNCTIONS
+/////////////////////////
+
+void pinMode(uint8_t pin, uint8_t mode) {
+	Mock_Pin_Mode[pin] = mode;
+	return;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+	Mock_Pin_Output[pin] = (value ? HIGH : LOW);
+	mock_pin_write_t Write = {Mock_Micros, pin, Mock_Pin_Output[pin]};
+	Mock_Pin_Writes.push_back(Write);
+	return;
+}
+
+int digitalRead(uint8_t pin) {
+	return ((Mock_Pin_Mode[pin] == OUTPUT) ? Mock_Pin_Output[pin] : Mock_Pin_Input[pin]);
+}
+
+// Runs the interrupts of every timer that is due, catching up on any that were delayed
+void runDueTimers() {
+	unsigned long Timer1_Period = ((2UL * ICR1) / (F_CPU / 1000000UL));
+
+	// Timer0 counts to 255 once per period; each compare interrupt fires as it passes its compare value
+	while((long) (Mock_Micros - Mock_Timer_Next[0]) >= 0) {
+		unsigned long Count = (((Mock_Timer_Next[0] - Mock_Timer0_Start) % MOCK_TIMER0_PERIOD) * 256) / MOCK_TIMER0_PERIOD;
+		if((Count == OCR0A) && (TIMSK0 & (1 << OCIE0A))) {
+			mockInterrupt(TIMER0_COMPA_vect);
+		}
+		if((Count == OCR0B) && (TIMSK0 & (1 << OCIE0B))) {
+			mockInterrupt(TIMER0_COMPB_vect);
+		}
+		Mock_Timer_Next[0] += (MOCK_TIMER0_PERIOD / 256);
+	}
+	while((long) (Mock_Micros - Mock_Timer_Next[1]) >= 0) {
+		Mock_Timer_Next[1] += max(Timer1_Period, 1UL);
+		if(TIMSK1 & (1 << TOIE1)) {
+			mockInterrupt(TIMER1_OVF_vect);
+		}
+	}
+	while((long) (Mock_Micros - Mock_Timer_Next[2]) >= 0) {
+		Mock_Timer_Next[2] += MOCK_TIMER2_PERIOD;
+		if(TIMSK2 & (1 << TOIE2)) {
+			mockInterrupt(TIMER2_OVF_vect);
+		}
+	}
+
+	// The ADC clock divisor is 2 ^ ADPS2:ADPS0, except that 0 also divides by 2
+	byte Adc_Divisor = max(1 << (ADCSRA & 0x07), 2);
+	unsigned long Adc_Period = ((MOCK_ADC_CONVERSION_CLOCKS * Adc_Divisor) / (F_CPU / 1000000UL));
+	byte Adc_Running = ((1 << ADEN) | (1 << ADSC) | (1 << ADATE) | (1 << ADIE));
+	while((long) (Mock_Micros - Mock_Adc_Next) >= 0) {
+		Mock_Adc_Next += max(Adc_Period, 1UL);
+		bool Converted = ((ADCSRA & Adc_Running) == Adc_Running);
+		if(Converted) {
+			ADC = Mock_Analog[Mock_Adc_Channel];
+		}
+		Mock_Adc_Channel = ((ADMUX & 0x0F) % MOCK_ANALOG_CHANNELS);
+		if(Converted) {
+			mockInterrupt(ADC_vect);
+		}
+	}
+	return;
+}
+
+unsigned long micros() {
+	if(SREG & (1 << SREG_I)) {
+		Mock_Stall_Count = 0;
+		Mock_Micros += MOCK_TIME_STEP;
+		if(Mock_Timers_Running) {
+			runDueTimers();
+		}
+	}
+	else if(++Mock_Stall_Count >= MOCK_STALL_LIMIT) {
+		fprintf(stderr, "time polled with interrupts disabled; the hardware would hang here\n");
+		abort();
+	}
+	return Mock_Micros;
+}
+
+unsigned long millis() {
+	return (micros() / 1000);
+}
+
+void delay(unsigned long ms) {
+	unsigned long Start = micros();
+	while((micros() - Start) < (ms * 1000)) {
+		// Wait
+	}
+	return;
+}
+
+void noInterrupts() {
+	SREG &= ~(1 << SREG_I);
+	return;
+}
+
+void interrupts() {
+	SREG |= (1 << SREG_I);
+	return;
+}
+
+void cli() {
+	noInterrupts();
+	return;
+}
+
+void sei() {
+	interrupts();
+	return;
+}
+
+void wdt_reset() {
+	Mock_Wdt_Resets += 1;
+	return;
+}
+
+void wdt_disable() {
+	Mock_Wdt_Enabled = false;
+	return;
+}
+
+
+/////////////////////////
+// MOCK FUNCTIONS
+/////////////////////////
+
+void mockReset() {
+	for(byte Pin = 0; Pin < NUM_DIGITAL_PINS; Pin++) {
+		Mock_Pin_Mode[Pin] = INPUT;
+		Mock_Pin_Input[Pin] = HIGH;
+		Mock_Pin_Output[Pin] = LOW;
+	}
+	Mock_Pin_Writes.clear();
+	Mock_Micros = 0;
+	Mock_Stall_Count = 0;
+	Mock_Timers_Running = false;
+	Mock_Adc_Channel = 0;
+	for(byte Channel = 0; Channel < MOCK_ANALOG_CHANNELS; Channel++) {
+		Mock_Analog[Channel] = 0;
+	}
+	SREG = (1 << SREG_I);
+	Serial.output.clear();
+	Serial.line_times.clear();
+	Serial.input.clear();
+	return;
+}
+
+void mockSetPin(uint8_t pin, uint8_t value) {
+	Mock_Pin_Input[pin] = (value ? HIGH : LOW);
+	return;
+}
+
+uint8_t mockGetPin(uint8_t pin) {
+	return Mock_Pin_Output[pin];
+}
+
+uint8_t mockReadPort(uint8_t port) {
+	// Port B is pins 8-13, port C is pins A0-A5, and port D is pins 0-7
+	byte First_Pin = ((port == 1) ? 8 : ((port == 2) ? A0 : 0));
+	byte Pin_Count = ((port == 3) ? 8 : 6);
+	byte Levels = 0;
+	for(byte Bit = 0; Bit < Pin_Count; Bit++) {
+		if(digitalRead(First_Pin + Bit)) {
+			Levels |= (1 << Bit);
+		}
+	}
+	return Levels;
+}
+
+uint8_t mockReadTimer0() {
+	return ((((Mock_Micros - Mock_Timer0_Start) % MOCK_TIMER0_PERIOD) * 256) / MOCK_TIMER0_PERIOD);
+}
+
+void mockAdvance(unsigned long us) {
+	Mock_Micros += us;
+	return;
+}
+
+void mockSetMicros(unsigned long us) {
+	Mock_Micros = us;
+	return;
+}
+
+void mockSetAnalog(uint8_t channel, uint16_t value) {
+	Mock_Analog[channel] = value;
+	return;
+}
+
+void mockRunTimers(bool enable) {
+	Mock_Timers_Running = enable;
+	Mock_Timer0_Start = Mock_Micros;
+	Mock_Timer_Next[0] = Mock_Micros;
+	Mock_Timer_Next[1] = Mock_Micros;
+	Mock_Timer_Next[2] = Mock_Micros + MOCK_TIMER2_PERIOD;
+	Mock_Adc_Next = Mock_Micros;
+	Mock_Adc_Channel = ((ADMUX & 0x0F) % MOCK_ANALOG_CHANNELS);
+	return;
+}
+
+bool mockInterrupt(void (*vector)()) {
+	uint8_t Old_SREG = SREG;
+	SREG &= ~(1 << SREG_I);
+	vector();
+	bool Disabled = !(SREG & (1 << SREG_I));
+
+	// RETI re-enables interrupts, so time would pass again
+	SREG = (Old_SREG | (1 << SREG_I));
+	Mock_Stall_Count = 0;
+	return Disabled;
+}
+
+const mock_pin_write_t *mockPinWrites(size_t *count) {
+	*count = Mock_Pin_Writes.size();
+	return Mock_Pin_Writes.data();
+}
+
+void mockClearPinWrites() {
+	Mock_Pin_Writes.clear();
+	return;
+}
+
+// Pins start as inputs reading HIGH, as with their pullups enabled
+static struct MockInit {
+	MockInit() {
+		mockReset();
+	}
+} Mock_Init;
@@ -0,0 +1,391 @@
+/* Mock Arduino Core
+ *
+ * Used to build the firmware modules on a Linux host for testing
+ *
+ * Only the parts of the Arduino core and the ATmega 328P register file used by the firmware are
+ * provided. Registers are plain variables, except for the pin input registers, which are read from
+ * the simulated pin levels. Bit positions match the ATmega 328P.
+ *
+ * The global interrupt flag is kept in SREG, as on the hardware. Time only passes while interrupts
+ * are enabled, since millis() and micros() are driven by the Timer0 overflow interrupt. Each call
+ * to millis() or micros() advances time by MOCK_TIME_STEP microseconds, so busy-wait loops end.
+ * Polling the time with interrupts disabled would hang the hardware, so it aborts the test.
+ * Timer interrupts run as time passes only once started with mockRunTimers(), so tests may
+ * otherwise run each interrupt themselves. The ADC converts the levels set with mockSetAnalog()
+ * and runs its interrupt in the same way, while free-running conversions are enabled.
+ *
+ * Note that int is 32 bits wide and long is 64 bits wide on the host, rather than 16 and 32 bits.
+ */
+
+#ifndef mock_arduino_h
+#define mock_arduino_h
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Standard headers used by the mock and tests must come before the min() and max() macros
+#include <map>
+#include <string>
+#include <vector>
+
+/////////////////////////
+// CONFIGURATION VARIABLES
+/////////////////////////
+
+// Time that passes with each call to millis() or micros()
+const unsigned long MOCK_TIME_STEP = 4;  // Microseconds
+
+// Number of times time may be polled with interrupts disabled before a test is aborted
+const unsigned long MOCK_STALL_LIMIT = 1000000;
+
+// Periods of the Timer0 and Timer2 interrupts, as configured by the Arduino core and the firmware
+// Timer1 overflows every 2 * ICR1 cycles, in phase and frequency correct PWM mode
+const unsigned long MOCK_TIMER0_PERIOD = 1024;   // Microseconds
+const unsigned long MOCK_TIMER2_PERIOD = 16384;  // Microseconds
+
+// Number of ADC clock cycles per conversion; the ADC clock is divided from F_CPU by ADPS2:ADPS0
+const unsigned long MOCK_ADC_CONVERSION_CLOCKS = 13;
+
+// Number of analog input channels
+#define MOCK_ANALOG_CHANNELS 8
+
+
+/////////////////////////
+// CORE DEFINITIONS
+/////////////////////////
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+
+#define NUM_DIGITAL_PINS 20
+const byte A0 = 14;
+const byte A1 = 15;
+const byte A2 = 16;
+const byte A3 = 17;
+const byte A4 = 18;
+const byte A5 = 19;
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define abs(x) ((x) > 0 ? (x) : -(x))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define PROGMEM
+#define memcpy_P memcpy
+#define pgm_read_byte(address) (*(const uint8_t *) (address))
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+// Interrupt routines become ordinary functions, which tests run with mockInterrupt()
+#define ISR(vector) void vector()
+
+// Inline assembly is marked by the host build (see the test Makefile) and run by hostAsm()
+#define HOST_ASM(...) hostAsm(#__VA_ARGS__)
+
+// AVR-only function attributes are ignored
+#define naked noinline
+#define section(name) unused
+
+
+/////////////////////////
+// REGISTER FILE
+/////////////////////////
+
+extern volatile uint8_t SREG;
+#define SREG_I 7
+
+extern volatile uint8_t MCUSR;
+#define WDRF 3
+#define BORF 2
+#define EXTRF 1
+#define PORF 0
+
+extern volatile uint8_t WDTCSR;
+#define WDIF 7
+#define WDIE 6
+#define WDP3 5
+#define WDCE 4
+#define WDE 3
+#define WDP2 2
+#define WDP1 1
+#define WDP0 0
+
+extern volatile uint8_t EICRA;
+#define ISC11 3
+#define ISC10 2
+#define ISC01 1
+#define ISC00 0
+
+extern volatile uint8_t EIMSK;
+#define INT1 1
+#define INT0 0
+
+extern volatile uint8_t OCR0A;
+extern volatile uint8_t OCR0B;
+extern volatile uint8_t TIMSK0;
+#define OCIE0B 2
+#define OCIE0A 1
+#define TOIE0 0
+
+// Timer0 interrupts run as soon as they are due, so none is ever left pending
+extern volatile uint8_t TIFR0;
+#define OCF0B 2
+#define OCF0A 1
+#define TOV0 0
+
+// The Timer0 count reflects the time since the timers were started
+#define TCNT0 (mockReadTimer0())
+
+extern volatile uint8_t PCICR;
+#define PCIE2 2
+#define PCIE1 1
+#define PCIE0 0
+
+extern volatile uint8_t PCMSK1;
+#define PCINT12 4
+#define PCINT11 3
+#define PCINT10 2
+
+extern volatile uint8_t PCMSK2;
+#define PCINT20 4
+
+extern volatile uint8_t TCCR1A;
+#define COM1A1 7
+#define COM1A0 6
+#define COM1B1 5
+#define COM1B0 4
+#define WGM11 1
+#define WGM10 0
+
+extern volatile uint8_t TCCR1B;
+#define WGM13 4
+#define WGM12 3
+#define CS12 2
+#define CS11 1
+#define CS10 0
+
+extern volatile uint16_t ICR1;
+extern volatile uint16_t OCR1A;
+extern volatile uint16_t OCR1B;
+extern volatile uint8_t TIMSK1;
+#define TOIE1 0
+
+extern volatile uint8_t TCCR2B;
+#define CS22 2
+#define CS21 1
+#define CS20 0
+
+extern volatile uint8_t TIMSK2;
+#define TOIE2 0
+
+extern volatile uint8_t ADMUX;
+#define REFS1 7
+#define REFS0 6
+
+extern volatile uint8_t ADCSRA;
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+
+extern volatile uint8_t ADCSRB;
+extern volatile uint8_t DIDR0;
+extern volatile uint16_t ADC;
+
+// Pin input registers reflect the simulated pin levels
+#define PINB (mockReadPort(1))
+#define PINC (mockReadPort(2))
+#define PIND (mockReadPort(3))
+
+
+/////////////////////////
+// SERIAL
+/////////////////////////
+
+class MockSerial {
+	public:
+		std::string output;   // Everything printed
+		std::vector<unsigned long> line_times;  // Time each line of output ended, in microseconds
+		std::string input;    // Characters waiting to be read
+		int write_space;      // Value returned by availableForWrite()
+
+		MockSerial();
+		void begin(unsigned long baud);
+		int available();
+		int read();
+		int availableForWrite();
+		void print(const __FlashStringHelper *text);
+		void print(const char *text);
+		void print(char character);
+		void print(unsigned char number, int base = DEC);
+		void print(int number, int base = DEC);
+		void print(unsigned int number, int base = DEC);
+		void print(long number, int base = DEC);
+		void print(unsigned long number, int base = DEC);
+
+	private:
+		void printNumber(unsigned long number, int base, bool negative);
+		void append(const char *text);
+};
+
+extern MockSerial Serial;
+
+
+/////////////////////////
+// INTERRUPT VECTORS
+/////////////////////////
+
+void INT0_vect();
+void INT1_vect();
+void PCINT1_vect();
+void PCINT2_vect();
+void WDT_vect();
+void TIMER2_OVF_vect();
+void TIMER1_OVF_vect();
+void TIMER0_COMPA_vect();
+void TIMER0_COMPB_vect();
+void ADC_vect();
+
+
+/////////////////////////
+// CORE FUNCTIONS
+/////////////////////////
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void noInterrupts();
+void interrupts();
+void cli();
+void sei();
+
+
+/////////////////////////
+// MOCK FUNCTIONS
+/////////////////////////
+
+typedef struct {
+	unsigned long time;  // Microseconds
+	uint8_t pin;
+	uint8_t value;
+} mock_pin_write_t;
+
+void mockReset();
+/*
+ * Returns the mock core to its power-on state
+ * Time restarts at 0, all pins are inputs reading HIGH, and interrupts are enabled
+ */
+
+void mockSetPin(uint8_t pin, uint8_t value);
+/*
+ * Sets the level seen on an input pin
+ *
+ * INPUT:  Pin number, level (HIGH or LOW)
+ */
+
+uint8_t mockGetPin(uint8_t pin);
+/*
+ * Gets the level last written to an output pin
+ *
+ * INPUT:  Pin number
+ * OUTPUT: Level (HIGH or LOW)
+ */
+
+uint8_t mockReadPort(uint8_t port);
+/*
+ * Reads a pin input register, as used by PINB, PINC and PIND
+ *
+ * INPUT:  Port (1 = B, 2 = C, 3 = D)
+ * OUTPUT: Level of each pin in the port
+ */
+
+uint8_t mockReadTimer0();
+/*
+ * Reads the Timer0 count, as used by TCNT0
+ *
+ * OUTPUT: Count (4 us each) since the start of the Timer0 period, as set by mockRunTimers()
+ */
+
+void mockAdvance(unsigned long us);
+/*
+ * Lets time pass, regardless of the interrupt flag
+ *
+ * INPUT:  Microseconds to pass
+ */
+
+void mockSetMicros(unsigned long us);
+/*
+ * Sets the current time
+ *
+ * INPUT:  Microseconds since reset
+ */
+
+void mockSetAnalog(uint8_t channel, uint16_t value);
+/*
+ * Sets the level seen on an analog input channel, as converted by the ADC
+ *
+ * INPUT:  ADC multiplexer channel, conversion result (0-1023)
+ */
+
+void mockRunTimers(bool enable);
+/*
+ * Starts or stops running the timer and ADC interrupts as time passes
+ * While started, each timer interrupt that is enabled by its mask register runs whenever it is
+ * due and time is polled with interrupts enabled, as it would on the hardware
+ * Likewise, while the ADC is enabled in free-running mode with its interrupt enabled, each
+ * conversion is stored in ADC and the ADC interrupt runs. As on the hardware, the next conversion
+ * starts as soon as one ends, so a change of ADMUX in the interrupt applies to the one after next.
+ *
+ * INPUT:  True to start, false to stop
+ */
+
+bool mockInterrupt(void (*vector)());
+/*
+ * Runs an interrupt routine as the hardware would, with interrupts disabled during the routine
+ *
+ * INPUT:  Interrupt routine
+ * OUTPUT: True if the routine left interrupts disabled, as it should
+ */
+
+const mock_pin_write_t *mockPinWrites(size_t *count);
+/*
+ * Gets the log of every digitalWrite() since the log was last cleared
+ *
+ * INPUT:  Location to store the number of entries
+ * OUTPUT: Log entries, oldest first
+ */
+
+void mockClearPinWrites();
+/*
+ * Clears the digitalWrite() log
+ */
+
+void hostAsm(const char *text);
+/*
+ * Runs an inline assembly statement of the firmware
+ * Implemented by the host build of the module that uses it
+ *
+ * INPUT:  Stringized assembly template and operands
+ */
+
+
+#endif
@@ -0,0 +1,497 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "avr-asm.h"
+
+namespace {
+
+std::string trim(const std::string &text) {
+	size_t Start = text.find_first_not_of(" \t\r\n");
+	if(Start == std::string::npos) {
+		return "";
+	}
+	size_t End = text.find_last_not_of(" \t\r\n");
+	return text.substr(Start, End - Start + 1);
+}
+
+// Collapses whitespace, so symbols match however the source was spaced
+std::string normalize(const std::string &text) {
+	std::string Result;
+	for(size_t i = 0; i < text.size(); i++) {
+		if(isspace((unsigned char) text[i])) {
+			continue;
+		}
+		if((text[i] == ',') && !Result.empty()) {
+			Result += ", ";
+			continue;
+		}
+		Result += text[i];
+	}
+	return Result;
+}
+
+// Splits on a separator, outside of parentheses, brackets and string literals
+std::vector<std::string> splitTop(const std::string &text, char separator) {
+	std::vector<std::string> Parts;
+	std::string Part;
+	int Depth = 0;
+	bool Quoted = false;
+	for(size_t i = 0; i < text.size(); i++) {
+		char Character = text[i];
+		if(Quoted) {
+			Part += Character;
+			if(Character == '\\') {
+				Part += text[++i];
+			}
+			else if(Character == '"') {
+				Quoted = false;
+			}
+			continue;
+		}
+		if(Character == '"') {
+			Quoted = true;
+		}
+		else if((Character == '(') || (Character == '[')) {
+			Depth += 1;
+		}
+		else if((Character == ')') || (Character == ']')) {
+			Depth -= 1;
+		}
+		else if((Character == separator) && (Depth == 0)) {
+			Parts.push_back(Part);
+			Part.clear();
+			continue;
+		}
+		Part += Character;
+	}
+	Parts.push_back(Part);
+	return Parts;
+}
+
+// Joins adjacent string literals, resolving escapes
+bool readLiterals(const std::string &text, std::string *result) {
+	result->clear();
+	for(size_t i = 0; i < text.size(); i++) {
+		if(isspace((unsigned char) text[i])) {
+			continue;
+		}
+		if(text[i] != '"') {
+			return false;
+		}
+		for(i++; (i < text.size()) && (text[i] != '"'); i++) {
+			if(text[i] != '\\') {
+				*result += text[i];
+				continue;
+			}
+			switch(text[++i]) {
+				case 'n': *result += '\n'; break;
+				case 't': *result += '\t'; break;
+				default: *result += text[i]; break;
+			}
+		}
+	}
+	return true;
+}
+
+bool parseNumber(const std::string &text, long *value) {
+	const char *Digits = text.c_str();
+	int Base = 10;
+	if((text.size() > 2) && (text[0] == '0') && ((text[1] == 'b') || (text[1] == 'B'))) {
+		Digits += 2;
+		Base = 2;
+	}
+	char *End;
+	*value = strtol(Digits, &End, (Base == 10) ? 0 : Base);
+	return ((*End == '\0') && (End != Digits));
+}
+
+// Finds the parenthesis closing the one that starts the text
+size_t closingParen(const std::string &text) {
+	int Depth = 0;
+	for(size_t i = 0; i < text.size(); i++) {
+		if(text[i] == '(') {
+			Depth += 1;
+		}
+		else if((text[i] == ')') && (--Depth == 0)) {
+			return i;
+		}
+	}
+	return std::string::npos;
+}
+
+// Evaluates a sum of numbers and symbols
+bool evaluate(const std::string &text, const avr_symbols_t &symbols, long *value) {
+	std::string Expression = normalize(text);
+	while((Expression.size() > 1) && (Expression[0] == '(') && (closingParen(Expression) == Expression.size() - 1)) {
+		Expression = Expression.substr(1, Expression.size() - 2);
+	}
+	*value = 0;
+	int Sign = 1;
+	std::string Term;
+	int Depth = 0;
+	for(size_t i = 0; i <= Expression.size(); i++) {
+		char Character = ((i < Expression.size()) ? Expression[i] : '\0');
+		if(Character == '(') {
+			Depth += 1;
+		}
+		else if(Character == ')') {
+			Depth -= 1;
+		}
+		if(((Character == '+') || (Character == '-') || (Character == '\0')) && (Depth == 0) && !Term.empty()) {
+			long Term_Value;
+			avr_symbols_t::const_iterator Symbol = symbols.find(Term);
+			if(Symbol != symbols.end()) {
+				Term_Value = Symbol->second;
+			}
+			else if(!parseNumber(Term, &Term_Value)) {
+				return false;
+			}
+			*value += Sign * Term_Value;
+			Sign = ((Character == '-') ? -1 : 1);
+			Term.clear();
+			continue;
+		}
+		Term += Character;
+	}
+	return true;
+}
+
+// Cycles taken by each instruction on the ATmega 328P
+int instructionCycles(const std::string &op, const std::vector<std::string> &args) {
+	if(op == "ld") {
+		return ((args[1][0] == '-') ? 3 : 2);
+	}
+	if((op == "st") || (op == "ldd") || (op == "std") || (op == "ijmp") || (op == "rjmp")
+		|| (op == "adiw") || (op == "sbiw")) {
+		return 2;
+	}
+	return 1;
+}
+
+}  // namespace
+
+
+AvrAsm::AvrAsm() {
+	for(int i = 0; i < 32; i++) {
+		reg[i] = 0;
+	}
+	for(unsigned int i = 0; i < AVR_DATA_SIZE; i++) {
+		data[i] = 0;
+	}
+	carry = false;
+	zero = false;
+	read_io = NULL;
+	cycles = 0;
+	instructions = 0;
+	base = AVR_PROGRAM_BASE;
+}
+
+bool AvrAsm::load(const char *text, const avr_symbols_t &symbols, uint16_t program_base) {
+	program.clear();
+	labels.clear();
+	pointers.clear();
+	base = program_base;
+
+	// Template : outputs : inputs : clobbers
+	std::vector<std::string> Sections = splitTop(text, ':');
+	std::string Template;
+	if(!readLiterals(Sections[0], &Template)) {
+		error = "template is not a string literal";
+		return false;
+	}
+
+	// Operands
+	avr_symbols_t Symbols;
+	for(avr_symbols_t::const_iterator Symbol = symbols.begin(); Symbol != symbols.end(); Symbol++) {
+		Symbols[normalize(Symbol->first)] = Symbol->second;
+	}
+	std::map<std::string, long> Named;
+	for(size_t Section = 1; (Section < 3) && (Section < Sections.size()); Section++) {
+		std::vector<std::string> Operands = splitTop(Sections[Section], ',');
+		for(size_t i = 0; i < Operands.size(); i++) {
+			std::string Operand = trim(Operands[i]);
+			if(Operand.empty()) {
+				continue;
+			}
+			std::string Name;
+			if(Operand[0] == '[') {
+				size_t Close = Operand.find(']');
+				Name = Operand.substr(1, Close - 1);
+				Operand = trim(Operand.substr(Close + 1));
+			}
+			size_t Constraint_End = Operand.find('"', 1);
+			std::string Constraint = Operand.substr(1, Constraint_End - 1);
+			long Value;
+			if(!evaluate(Operand.substr(Constraint_End + 1), Symbols, &Value)) {
+				error = "cannot evaluate operand: " + Operand;
+				return false;
+			}
+			if((Constraint == "x") || (Constraint == "y") || (Constraint == "z")) {
+				pointers[Constraint[0]] = Value;
+			}
+			if(!Name.empty()) {
+				Named[Name] = Value;
+			}
+		}
+	}
+
+	// Substitute operands and unique labels
+	std::string Source;
+	for(size_t i = 0; i < Template.size(); i++) {
+		if((Template[i] == '%') && (i + 1 < Template.size()) && (Template[i + 1] == '=')) {
+			Source += "0";
+			i += 1;
+		}
+		else if((Template[i] == '%') && (i + 1 < Template.size()) && (Template[i + 1] == '[')) {
+			size_t Close = Template.find(']', i);
+			std::string Name = Template.substr(i + 2, Close - i - 2);
+			if(Named.find(Name) == Named.end()) {
+				error = "unknown operand: " + Name;
+				return false;
+			}
+			char Value[24];
+			snprintf(Value, sizeof(Value), "%ld", Named[Name]);
+			Source += Value;
+			i = Close;
+		}
+		else {
+			Source += Template[i];
+		}
+	}
+
+	// Instructions and labels
+	std::vector<std::string> Lines = splitTop(Source, '\n');
+	for(size_t i = 0; i < Lines.size(); i++) {
+		std::string Line = trim(Lines[i]);
+		if(Line.empty()) {
+			continue;
+		}
+		if(Line[Line.size() - 1] == ':') {
+			labels[Line.substr(0, Line.size() - 1)] = program.size();
+			continue;
+		}
+		avr_instruction_t Instruction;
+		size_t Split = Line.find_first_of(" \t");
+		Instruction.op = Line.substr(0, Split);
+		if(Split != std::string::npos) {
+			std::vector<std::string> Args = splitTop(Line.substr(Split), ',');
+			for(size_t Arg = 0; Arg < Args.size(); Arg++) {
+				Instruction.args.push_back(trim(Args[Arg]));
+			}
+		}
+		program.push_back(Instruction);
+	}
+	return true;
+}
+
+void AvrAsm::run() {
+	cycles = 0;
+	instructions = 0;
+	for(std::map<char, long>::iterator Pointer = pointers.begin(); Pointer != pointers.end(); Pointer++) {
+		setPair(26 + ((Pointer->first - 'x') * 2), Pointer->second);
+	}
+
+	size_t PC = 0;
+	while(PC < program.size()) {
+		const avr_instruction_t &Instruction = program[PC];
+		const std::string &Op = Instruction.op;
+		const std::vector<std::string> &Args = Instruction.args;
+		cycles += instructionCycles(Op, Args);
+		instructions += 1;
+		PC += 1;
+
+		if((Op == "ld") || (Op == "st")) {
+			bool Load = (Op == "ld");
+			std::string Pointer = Args[Load ? 1 : 0];
+			uint8_t &Reg = regOperand(Args[Load ? 0 : 1]);
+			bool Pre_Decrement = (Pointer[0] == '-');
+			bool Post_Increment = (Pointer[Pointer.size() - 1] == '+');
+			char Name = Pointer[Pre_Decrement ? 1 : 0];
+			int Low = 26 + ((tolower(Name) - 'x') * 2);
+			uint16_t Address = pair(Low);
+			if(Pre_Decrement) {
+				Address -= 1;
+			}
+			if(Load) {
+				Reg = readData(Address);
+			}
+			else {
+				writeData(Address, Reg);
+			}
+			if(Post_Increment) {
+				Address += 1;
+			}
+			setPair(Low, Address);
+		}
+		else if((Op == "ldd") || (Op == "std")) {
+			bool Load = (Op == "ldd");
+			std::string Pointer = Args[Load ? 1 : 0];
+			uint8_t &Reg = regOperand(Args[Load ? 0 : 1]);
+			int Low = 26 + ((tolower(Pointer[0]) - 'x') * 2);
+			uint16_t Address = pair(Low) + immediate(Pointer.substr(2));
+			if(Load) {
+				Reg = readData(Address);
+			}
+			else {
+				writeData(Address, Reg);
+			}
+		}
+		else if(Op == "in") {
+			regOperand(Args[0]) = readData(immediate(Args[1]) + AVR_IO_OFFSET);
+		}
+		else if(Op == "out") {
+			writeData(immediate(Args[0]) + AVR_IO_OFFSET, regOperand(Args[1]));
+		}
+		else if((Op == "ldi") || (Op == "mov")) {
+			regOperand(Args[0]) = ((Op == "ldi") ? (uint8_t) immediate(Args[1]) : regOperand(Args[1]));
+		}
+		else if(Op == "movw") {
+			int Destination = atoi(Args[0].c_str() + 1);
+			int Source = atoi(Args[1].c_str() + 1);
+			reg[Destination] = reg[Source];
+			reg[Destination + 1] = reg[Source + 1];
+		}
+		else if((Op == "andi") || (Op == "and") || (Op == "ori") || (Op == "or") || (Op == "eor") || (Op == "clr")) {
+			uint8_t &Destination = regOperand(Args[0]);
+			uint8_t Source = ((Op == "clr") ? Destination : ((Op[Op.size() - 1] == 'i') ? (uint8_t) immediate(Args[1]) : regOperand(Args[1])));
+			if(Op[0] == 'a') {
+				Destination &= Source;
+			}
+			else if(Op[0] == 'o') {
+				Destination |= Source;
+			}
+			else {
+				Destination ^= Source;
+			}
+			zero = (Destination == 0);
+		}
+		else if((Op == "add") || (Op == "adc")) {
+			uint8_t &Destination = regOperand(Args[0]);
+			unsigned int Result = Destination + regOperand(Args[1]) + ((Op == "adc") && carry);
+			carry = (Result > 0xFF);
+			Destination = Result;
+			zero = (Destination == 0);
+		}
+		else if((Op == "sub") || (Op == "subi") || (Op == "sbc") || (Op == "sbci")) {
+			uint8_t &Destination = regOperand(Args[0]);
+			uint8_t Source = ((Op[Op.size() - 1] == 'i') ? (uint8_t) immediate(Args[1]) : regOperand(Args[1]));
+			bool With_Carry = ((Op == "sbc") || (Op == "sbci"));
+			int Result = Destination - Source - (With_Carry && carry);
+			carry = (Result < 0);
+			Destination = Result;
+			zero = (With_Carry ? (zero && (Destination == 0)) : (Destination == 0));
+		}
+		else if((Op == "inc") || (Op == "dec")) {
+			uint8_t &Destination = regOperand(Args[0]);
+			Destination += ((Op == "inc") ? 1 : -1);
+			zero = (Destination == 0);
+		}
+		else if((Op == "asr") || (Op == "lsr") || (Op == "lsl")) {
+			uint8_t &Destination = regOperand(Args[0]);
+			if(Op == "lsl") {
+				carry = (Destination & 0x80);
+				Destination <<= 1;
+			}
+			else {
+				carry = (Destination & 0x01);
+				Destination = ((Op == "asr") ? ((Destination >> 1) | (Destination & 0x80)) : (Destination >> 1));
+			}
+			zero = (Destination == 0);
+		}
+		else if(Op == "rjmp") {
+			if(labels.find(Args[0]) == labels.end()) {
+				fail("unknown label " + Args[0]);
+			}
+			PC = labels[Args[0]];
+		}
+		else if(Op == "ijmp") {
+			long Target = (long) pair(30) - base;
+			if((Target < 0) || (Target >= (long) program.size())) {
+				fail("ijmp outside the statement");
+			}
+			PC = Target;
+		}
+		else {
+			fail("unsupported instruction " + Op);
+		}
+	}
+	return;
+}
+
+uint8_t &AvrAsm::regOperand(const std::string &text) {
+	if(text == "__zero_reg__") {
+		return reg[1];
+	}
+	if(text == "__tmp_reg__") {
+		return reg[0];
+	}
+	if((text.size() < 2) || (text[0] != 'r')) {
+		fail("expected a register, found " + text);
+	}
+	int Number = atoi(text.c_str() + 1);
+	if((Number < 0) || (Number > 31)) {
+		fail("bad register " + text);
+	}
+	return reg[Number];
+}
+
+long AvrAsm::immediate(const std::string &text) {
+	std::string Value = trim(text);
+	bool High = (Value.compare(0, 4, "hi8(") == 0);
+	if(High || (Value.compare(0, 4, "lo8(") == 0)) {
+		long Inner = immediate(Value.substr(4, Value.size() - 5));
+		return (High ? ((Inner >> 8) & 0xFF) : (Inner & 0xFF));
+	}
+	if(Value.compare(0, 3, "pm(") == 0) {
+		std::string Label = Value.substr(3, Value.size() - 4);
+		if(labels.find(Label) == labels.end()) {
+			fail("unknown label " + Label);
+		}
+		return base + labels[Label];
+	}
+	long Number;
+	if(!parseNumber(Value, &Number)) {
+		fail("bad immediate " + Value);
+	}
+	return Number;
+}
+
+uint16_t AvrAsm::pair(int low) {
+	return (reg[low] | (reg[low + 1] << 8));
+}
+
+void AvrAsm::setPair(int low, uint16_t value) {
+	reg[low] = (value & 0xFF);
+	reg[low + 1] = (value >> 8);
+	return;
+}
+
+uint8_t AvrAsm::readData(uint16_t address) {
+	if(address < 32) {
+		return reg[address];
+	}
+	if((address < (AVR_IO_OFFSET + 0x40)) && (read_io != NULL)) {
+		return read_io(address - AVR_IO_OFFSET);
+	}
+	if(address >= AVR_DATA_SIZE) {
+		fail("read outside the data space");
+	}
+	return data[address];
+}
+
+void AvrAsm::writeData(uint16_t address, uint8_t value) {
+	if(address < 32) {
+		reg[address] = value;
+		return;
+	}
+	if(address >= AVR_DATA_SIZE) {
+		fail("write outside the data space");
+	}
+	data[address] = value;
+	return;
+}
+
+void AvrAsm::fail(const std::string &message) {
+	fprintf(stderr, "avr-asm: %s\n", message.c_str());
+	abort();
+}
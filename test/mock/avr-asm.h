@@ -0,0 +1,96 @@
+/* AVR Assembly Interpreter
+ *
+ * Used to run the firmware's inline assembly on a Linux host
+ *
+ * An inline assembly statement is loaded from its stringized template and operands, as passed to
+ * hostAsm(). Named operands are evaluated from a table of symbols supplied by the caller, such as
+ * structure offsets and I/O addresses as they are on the ATmega 328P. Pointer register operands
+ * ("x", "y" or "z") are loaded into their register pair before the statement runs.
+ *
+ * Only the instructions used by the firmware are supported, along with their carry and zero flags.
+ * Each instruction is treated as one word of program memory, so jump tables of rjmp instructions
+ * work with ijmp. Cycle counts follow the ATmega 328P datasheet, so the cost of each path through
+ * a statement can be measured.
+ */
+
+#ifndef avr_asm_h
+#define avr_asm_h
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/////////////////////////
+// CONFIGURATION VARIABLES
+/////////////////////////
+
+// Size of the simulated data space, including the register file and I/O registers
+const unsigned int AVR_DATA_SIZE = 0x900;
+
+// Offset of the I/O registers in the data space
+const unsigned int AVR_IO_OFFSET = 0x20;
+
+// Default program memory word address of the first instruction
+const uint16_t AVR_PROGRAM_BASE = 0x0100;
+
+
+/////////////////////////
+// DATA STRUCTURES
+/////////////////////////
+
+typedef std::map<std::string, long> avr_symbols_t;
+
+typedef struct {
+	std::string op;
+	std::vector<std::string> args;
+} avr_instruction_t;
+
+
+/////////////////////////
+// INTERPRETER
+/////////////////////////
+
+class AvrAsm {
+	public:
+		uint8_t reg[32];
+		uint8_t data[AVR_DATA_SIZE];
+		bool carry;
+		bool zero;
+		uint8_t (*read_io)(uint8_t address);  // Reads an I/O register not held in data[]
+		unsigned long cycles;                  // Cycles taken by the last run
+		unsigned long instructions;            // Instructions executed by the last run
+
+		AvrAsm();
+		bool load(const char *text, const avr_symbols_t &symbols, uint16_t base = AVR_PROGRAM_BASE);
+		/*
+		 * Loads a stringized inline assembly statement
+		 *
+		 * INPUT:  Template and operands, values of the symbols used by operands, program address
+		 * OUTPUT: True if loaded; otherwise error describes the problem
+		 */
+
+		void run();
+		/*
+		 * Loads the pointer register operands and runs the statement to its end
+		 * Aborts on an unsupported instruction or a jump outside the statement
+		 */
+
+		std::string error;
+
+	private:
+		std::vector<avr_instruction_t> program;
+		std::map<std::string, int> labels;
+		std::map<char, long> pointers;  // Pointer register operands, by register pair
+		uint16_t base;
+
+		uint8_t &regOperand(const std::string &text);
+		long immediate(const std::string &text);
+		uint16_t pair(int low);
+		void setPair(int low, uint16_t value);
+		uint8_t readData(uint16_t address);
+		void writeData(uint16_t address, uint8_t value);
+		void fail(const std::string &message);
+};
+
+
+#endif
@@ -0,0 +1,17 @@
+/* Mock Watchdog Timer
+ *
+ * Counts WDT resets, so tests can check when the supervisor resets the WDT
+ */
+
+#ifndef mock_wdt_h
+#define mock_wdt_h
+#include "../Arduino.h"
+
+extern unsigned long Mock_Wdt_Resets;
+extern bool Mock_Wdt_Enabled;
+
+void wdt_reset();
+void wdt_disable();
+
+
+#endif
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <map>
+#include "host-asm.h"
+#include "avr-asm.h"
+#include "safety-encoder.h"
+
+extern encoder_data_t Encoder_Data;
+
+std::map<const char *, AvrAsm *> Host_Asm_Programs;
+uint16_t Host_Asm_Base = AVR_PROGRAM_BASE;
+unsigned long Host_Asm_Cycles = 0;
+unsigned long Host_Asm_Instructions = 0;
+
+// Offsets within encoder_data_t on the ATmega 328P, which packs structures
+const uint16_t AVR_ENCODER_STATE = 0;
+const uint16_t AVR_ENCODER_POSITION = 1;
+const uint16_t AVR_ENCODER_SKIPPED_INT0 = 5;
+const uint16_t AVR_ENCODER_SKIPPED_INT1 = 6;
+
+uint8_t readHostIo(uint8_t address) {
+	if(address == HOST_PIND_ADDRESS) {
+		return PIND;
+	}
+	fprintf(stderr, "host-asm: unsupported I/O read at 0x%02X\n", address);
+	abort();
+}
+
+AvrAsm *loadHostAsm(const char *text) {
+	AvrAsm *Program = Host_Asm_Programs[text];
+	if(Program != NULL) {
+		return Program;
+	}
+
+	avr_symbols_t Symbols;
+	Symbols["&Encoder_Data"] = HOST_ENCODER_ADDRESS;
+	Symbols["_SFR_IO_ADDR(PIND)"] = HOST_PIND_ADDRESS;
+	Symbols["offsetof(encoder_data_t, state)"] = AVR_ENCODER_STATE;
+	Symbols["offsetof(encoder_data_t, position)"] = AVR_ENCODER_POSITION;
+	Symbols["offsetof(encoder_data_t, skipped_int0)"] = AVR_ENCODER_SKIPPED_INT0;
+	Symbols["offsetof(encoder_data_t, skipped_int1)"] = AVR_ENCODER_SKIPPED_INT1;
+
+	Program = new AvrAsm();
+	if(!Program->load(text, Symbols, Host_Asm_Base)) {
+		fprintf(stderr, "host-asm: %s\n", Program->error.c_str());
+		abort();
+	}
+	Program->read_io = readHostIo;
+	Host_Asm_Programs[text] = Program;
+	return Program;
+}
+
+void hostAsm(const char *text) {
+	AvrAsm *Program = loadHostAsm(text);
+	uint8_t *Data = &Program->data[HOST_ENCODER_ADDRESS];
+
+	Data[AVR_ENCODER_STATE] = Encoder_Data.state;
+	uint32_t Position = Encoder_Data.position;
+	for(byte i = 0; i < 4; i++) {
+		Data[AVR_ENCODER_POSITION + i] = (Position >> (8 * i));
+	}
+	Data[AVR_ENCODER_SKIPPED_INT0] = Encoder_Data.skipped_int0;
+	Data[AVR_ENCODER_SKIPPED_INT1] = Encoder_Data.skipped_int1;
+
+	Program->run();
+	Host_Asm_Cycles = Program->cycles;
+	Host_Asm_Instructions = Program->instructions;
+
+	Encoder_Data.state = Data[AVR_ENCODER_STATE];
+	Position = 0;
+	for(byte i = 0; i < 4; i++) {
+		Position |= ((uint32_t) Data[AVR_ENCODER_POSITION + i] << (8 * i));
+	}
+	Encoder_Data.position = Position;
+	Encoder_Data.skipped_int0 = Data[AVR_ENCODER_SKIPPED_INT0];
+	Encoder_Data.skipped_int1 = Data[AVR_ENCODER_SKIPPED_INT1];
+	return;
+}
+
+void setHostAsmBase(uint16_t base) {
+	for(std::map<const char *, AvrAsm *>::iterator Program = Host_Asm_Programs.begin(); Program != Host_Asm_Programs.end(); Program++) {
+		delete Program->second;
+	}
+	Host_Asm_Programs.clear();
+	Host_Asm_Base = base;
+	return;
+}
+
+unsigned long getHostAsmCycles() {
+	return Host_Asm_Cycles;
+}
+
+unsigned long getHostAsmInstructions() {
+	return Host_Asm_Instructions;
+}
@@ -0,0 +1,54 @@
+/* Host Inline Assembly
+ *
+ * Used to run the firmware's inline assembly on a Linux host, with the AVR Assembly Interpreter
+ *
+ * The host build rewrites each "asm volatile (" statement of the firmware as HOST_ASM(), which
+ * passes the statement to hostAsm() as text. The data used by the statement is copied into the
+ * simulated AVR data space, arranged as it is on the ATmega 328P, and copied back afterward.
+ *
+ * Only the Encoder Module uses inline assembly, from its INT0 and INT1 interrupt routines.
+ */
+
+#ifndef host_asm_h
+#define host_asm_h
+#include <Arduino.h>
+
+/////////////////////////
+// CONFIGURATION VARIABLES
+/////////////////////////
+
+// Data space address of Encoder_Data, as seen by the assembly
+const uint16_t HOST_ENCODER_ADDRESS = 0x0100;
+
+// I/O address of the PIND register
+const uint8_t HOST_PIND_ADDRESS = 0x09;
+
+
+/////////////////////////
+// AVAILABLE FUNCTIONS
+/////////////////////////
+
+void setHostAsmBase(uint16_t base);
+/*
+ * Sets the program memory address at which each statement is placed
+ * Used to check that jump tables work wherever they are linked
+ *
+ * INPUT:  Word address of the first instruction
+ */
+
+unsigned long getHostAsmCycles();
+/*
+ * Gets the number of AVR cycles taken by the last statement run
+ *
+ * OUTPUT: Cycles
+ */
+
+unsigned long getHostAsmInstructions();
+/*
+ * Gets the number of AVR instructions executed by the last statement run
+ *
+ * OUTPUT: Instructions
+ */
+
+
+#endif
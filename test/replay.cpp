@@ -0,0 +1,434 @@
+/* Trace Replay Tool
+ *
+ * Replays an input trace through the firmware on a Linux host, at full speed
+ *
+ *   replay [-o <output>] [-b <baseline>] [-t <tolerance>] [-e <ms>] [-l <us>] <trace>
+ *
+ * The trace is a serial log recorded with TRACE_ENABLED set (see trace.h). Starting from the input
+ * levels in its "TRACE" header, each record's input levels are applied to the simulated pins at
+ * its tick, or at its time after the tick, running the pin change interrupts as on the hardware.
+ * A record's encoder position change is replayed as quadrature edges on the encoder pins, spread
+ * evenly since the previous record, each running the INT0 or INT1 interrupt, so the encoder is
+ * decoded as on the hardware. If the recorded encoder pin levels show an edge was missed, they are
+ * then applied as recorded, so the missed edge is also counted as on the hardware. The
+ * firmware runs loop() throughout, with its timer interrupts running as on the hardware. Replay
+ * continues for a further 1000 ms (or as set with -e) after the last record. Time only passes on the
+ * host when the firmware polls it, so each loop() is also taken to last REPLAY_LOOP_TIME (or as set
+ * with -l), which sets how many times inputs are read per tick, as on the hardware.
+ *
+ * The firmware's output is then compared with the output recorded in the trace, or with a baseline
+ * written by an earlier replay with -o. Each state machine transition is included in the output as
+ * a "= STATE <state> @ <ms>" line, which is compared with a baseline but not with a recording.
+ * By default, only the text of each line is compared, as times differ slightly from the recording.
+ * With -t, numbers are also compared, and may differ by up to the given tolerance.
+ *
+ * Differences are printed as lines missing from (-) or added to (+) the replay, with the time they
+ * were printed in milliseconds. The exit status is 1 if there are any differences.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../CML-Firmware.h"
+
+// Lines searched ahead to find where the replay and the expected output agree again
+const size_t REPLAY_RESYNC_LINES = 16;
+
+const unsigned long REPLAY_DEFAULT_END = 1000;  // Milliseconds
+
+// Estimated time of an idle loop() on the ATmega 328P, mostly spent reading inputs
+const unsigned long REPLAY_LOOP_TIME = 40;  // Microseconds
+
+extern state_t Current_State;
+
+void setup();
+void loop();
+
+typedef struct {
+	unsigned long time;  // Milliseconds
+	std::string text;
+} replay_line_t;
+
+typedef struct {
+	unsigned long ticks;
+	unsigned long offset;  // Microseconds after the tick
+	byte inputs;
+	int32_t delta;
+	bool lost;             // Changes were merged into this record
+} replay_record_t;
+
+// Encoder pin levels, as (ENC_B << 1) | ENC_A, in order of positive movement
+const byte REPLAY_QUADRATURE[4] = {0b00, 0b10, 0b11, 0b01};
+
+unsigned long Replay_Loop_Time = REPLAY_LOOP_TIME;
+std::vector<replay_line_t> Replay_Output;
+std::string Replay_Partial_Line;
+state_t Replay_Last_State = INIT;
+byte Replay_Inputs = 0;
+
+
+/////////////////////////
+// TRACE INPUT
+/////////////////////////
+
+bool readTrace(const char *path, unsigned long *tick_length, byte *initial_inputs,
+	std::vector<replay_record_t> *records, std::vector<replay_line_t> *expected) {
+
+	FILE *File = fopen(path, "r");
+	if(File == NULL) {
+		perror(path);
+		return false;
+	}
+
+	char Line[256];
+	bool Started = false;
+	bool Lost = false;
+	unsigned long Ticks = 0;
+	while(fgets(Line, sizeof(Line), File) != NULL) {
+		Line[strcspn(Line, "\r\n")] = '\0';
+		unsigned int Tick_Length;
+		unsigned int Inputs;
+		if(sscanf(Line, "TRACE %u %x", &Tick_Length, &Inputs) == 2) {
+			// Only the last trace in the log is replayed
+			*tick_length = Tick_Length;
+			*initial_inputs = Inputs;
+			records->clear();
+			expected->clear();
+			Started = true;
+			Ticks = 0;
+			continue;
+		}
+		if(!Started) {
+			continue;
+		}
+
+		// Lost changes were merged into the record that follows
+		unsigned int Record_Ticks;
+		unsigned int Offset = 0;
+		int Delta;
+		unsigned int Merged;
+		if(sscanf(Line, "@!%u", &Merged) == 1) {
+			Lost = true;
+		}
+		else if((sscanf(Line, "@%u+%u,%x,%d", &Record_Ticks, &Offset, &Inputs, &Delta) == 4)
+			|| (sscanf(Line, "@%u,%x,%d", &Record_Ticks, &Inputs, &Delta) == 3)) {
+			replay_record_t Record = {Record_Ticks, Offset, (byte) Inputs, Delta, Lost};
+			records->push_back(Record);
+			Ticks += Record_Ticks;
+			Lost = false;
+		}
+		else if(Line[0] != '@') {
+			replay_line_t Expected = {(Ticks * (*tick_length)) / 1000, Line};
+			expected->push_back(Expected);
+		}
+	}
+	fclose(File);
+	if(!Started) {
+		fprintf(stderr, "%s: no TRACE header found\n", path);
+	}
+	return Started;
+}
+
+bool readBaseline(const char *path, std::vector<replay_line_t> *expected) {
+	FILE *File = fopen(path, "r");
+	if(File == NULL) {
+		perror(path);
+		return false;
+	}
+	char Line[256];
+	while(fgets(Line, sizeof(Line), File) != NULL) {
+		Line[strcspn(Line, "\r\n")] = '\0';
+		unsigned long Time;
+		int Length;
+		if(sscanf(Line, "%lu %n", &Time, &Length) != 1) {
+			continue;
+		}
+		replay_line_t Expected = {Time, &Line[Length]};
+		expected->push_back(Expected);
+	}
+	fclose(File);
+	return true;
+}
+
+
+/////////////////////////
+// REPLAY
+/////////////////////////
+
+// Sets the input levels, running the interrupts of any pins that changed
+void setInputs(byte inputs) {
+	byte Changed = (inputs ^ Replay_Inputs);
+	Replay_Inputs = inputs;
+	mockSetPin(ENC_A_PIN, (inputs & 0x01) ? HIGH : LOW);
+	mockSetPin(ENC_B_PIN, (inputs & 0x02) ? HIGH : LOW);
+	mockSetPin(ENDSTOP_0_PIN, (inputs & 0x04) ? HIGH : LOW);
+	mockSetPin(BACK_PIN, (inputs & 0x08) ? HIGH : LOW);
+	mockSetPin(FORW_PIN, (inputs & 0x10) ? HIGH : LOW);
+	mockSetPin(GO_PIN, (inputs & 0x20) ? HIGH : LOW);
+
+	// Pending interrupts run in order of priority
+	if((Changed & 0x01) && (EIMSK & (1 << INT0))) {
+		mockInterrupt(INT0_vect);
+	}
+	if((Changed & 0x02) && (EIMSK & (1 << INT1))) {
+		mockInterrupt(INT1_vect);
+	}
+	if((Changed & 0x38) && (PCICR & (1 << PCIE1)) && (PCMSK1 & ((1 << PCINT10) | (1 << PCINT11) | (1 << PCINT12)))) {
+		mockInterrupt(PCINT1_vect);
+	}
+	if((Changed & 0x04) && (PCICR & (1 << PCIE2)) && (PCMSK2 & (1 << PCINT20))) {
+		mockInterrupt(PCINT2_vect);
+	}
+	return;
+}
+
+// Moves the encoder by one edge in a direction
+void stepEncoder(int direction) {
+	byte Phase = 0;
+	while(REPLAY_QUADRATURE[Phase] != (Replay_Inputs & 0x03)) {
+		Phase += 1;
+	}
+	setInputs((Replay_Inputs & ~0x03) | REPLAY_QUADRATURE[(Phase + direction) & 0x03]);
+	return;
+}
+
+// Collects each line of serial output and each state change, with the time it appeared
+void collectOutput() {
+	size_t Line_Count = 0;
+	for(size_t i = 0; i < Serial.output.size(); i++) {
+		char Character = Serial.output[i];
+		if(Character != '\n') {
+			Replay_Partial_Line += Character;
+			continue;
+		}
+
+		// Trace records and headers are not part of the firmware's usual output
+		if((Replay_Partial_Line[0] != '@') && (Replay_Partial_Line.compare(0, 6, "TRACE ") != 0)) {
+			replay_line_t Line = {Serial.line_times[Line_Count] / 1000, Replay_Partial_Line};
+			Replay_Output.push_back(Line);
+		}
+		Replay_Partial_Line.clear();
+		Line_Count += 1;
+	}
+
+	// Keep memory use flat over long replays
+	Serial.output.clear();
+	Serial.line_times.clear();
+	mockClearPinWrites();
+
+	if(Current_State != Replay_Last_State) {
+		unsigned long Now = (micros() / 1000);
+		char Text[32];
+		snprintf(Text, sizeof(Text), "= STATE %d @ %lu", Current_State, Now);
+		replay_line_t Line = {Now, Text};
+		Replay_Output.push_back(Line);
+		Replay_Last_State = Current_State;
+	}
+	return;
+}
+
+void runUntil(unsigned long us) {
+	while((long) (micros() - us) < 0) {
+		loop();
+		mockAdvance(Replay_Loop_Time);
+		collectOutput();
+	}
+	return;
+}
+
+// Replays a record, from the time of the previous record
+void replayRecord(const replay_record_t &record, unsigned long start, unsigned long end) {
+	unsigned long Edges = labs(record.delta);
+	for(unsigned long Edge = 1; Edge <= Edges; Edge++) {
+		runUntil(start + (((end - start) * Edge) / (Edges + 1)));
+		stepEncoder((record.delta > 0) ? 1 : -1);
+	}
+	runUntil(end);
+	setInputs(record.inputs);
+	return;
+}
+
+
+/////////////////////////
+// COMPARISON
+/////////////////////////
+
+// Compares two lines, ignoring numbers if tolerance is negative
+bool linesMatch(const std::string &a, const std::string &b, long tolerance) {
+	size_t i = 0;
+	size_t j = 0;
+	while((i < a.size()) && (j < b.size())) {
+		bool Number_A = (isdigit((unsigned char) a[i]) || ((a[i] == '-') && isdigit((unsigned char) a[i + 1])));
+		bool Number_B = (isdigit((unsigned char) b[j]) || ((b[j] == '-') && isdigit((unsigned char) b[j + 1])));
+		if(Number_A && Number_B) {
+			char *End_A;
+			char *End_B;
+			long Value_A = strtol(a.c_str() + i, &End_A, 10);
+			long Value_B = strtol(b.c_str() + j, &End_B, 10);
+			if((tolerance >= 0) && (labs(Value_A - Value_B) > tolerance)) {
+				return false;
+			}
+			i = End_A - a.c_str();
+			j = End_B - b.c_str();
+			continue;
+		}
+		if(a[i++] != b[j++]) {
+			return false;
+		}
+	}
+	return ((i == a.size()) && (j == b.size()));
+}
+
+void printLine(char change, const replay_line_t &line) {
+	printf("%c %8lu %s\n", change, line.time, line.text.c_str());
+	return;
+}
+
+// Prints the differences between the expected and replayed output, and returns their number
+unsigned long compareOutput(const std::vector<replay_line_t> &expected, const std::vector<replay_line_t> &replayed, long tolerance) {
+	unsigned long Differences = 0;
+	size_t i = 0;
+	size_t j = 0;
+	while((i < expected.size()) || (j < replayed.size())) {
+		if((i < expected.size()) && (j < replayed.size()) && linesMatch(expected[i].text, replayed[j].text, tolerance)) {
+			i += 1;
+			j += 1;
+			continue;
+		}
+
+		// Find the nearest point where the two agree again
+		size_t Missing = 0;
+		size_t Added = 0;
+		for(size_t Offset = 1; (Offset <= REPLAY_RESYNC_LINES) && (Missing == 0) && (Added == 0); Offset++) {
+			if((i + Offset < expected.size()) && (j < replayed.size()) && linesMatch(expected[i + Offset].text, replayed[j].text, tolerance)) {
+				Missing = Offset;
+			}
+			else if((j + Offset < replayed.size()) && (i < expected.size()) && linesMatch(expected[i].text, replayed[j + Offset].text, tolerance)) {
+				Added = Offset;
+			}
+		}
+		if((Missing == 0) && (Added == 0)) {
+			Missing = ((i < expected.size()) ? 1 : 0);
+			Added = ((j < replayed.size()) ? 1 : 0);
+		}
+		for(; Missing > 0; Missing--, i++) {
+			printLine('-', expected[i]);
+			Differences += 1;
+		}
+		for(; Added > 0; Added--, j++) {
+			printLine('+', replayed[j]);
+			Differences += 1;
+		}
+	}
+	return Differences;
+}
+
+
+/////////////////////////
+// MAIN
+/////////////////////////
+
+void usage() {
+	fprintf(stderr, "usage: replay [-o <output>] [-b <baseline>] [-t <tolerance>] [-e <ms>] [-l <us>] <trace>\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[]) {
+	const char *Output_Path = NULL;
+	const char *Baseline_Path = NULL;
+	long Tolerance = -1;
+	unsigned long End_Time = REPLAY_DEFAULT_END;
+	int Option;
+	while((Option = getopt(argc, argv, "o:b:t:e:l:")) != -1) {
+		switch(Option) {
+			case 'o':
+				Output_Path = optarg;
+				break;
+			case 'b':
+				Baseline_Path = optarg;
+				break;
+			case 't':
+				Tolerance = atol(optarg);
+				break;
+			case 'e':
+				End_Time = strtoul(optarg, NULL, 10);
+				break;
+			case 'l':
+				Replay_Loop_Time = strtoul(optarg, NULL, 10);
+				break;
+			default:
+				usage();
+		}
+	}
+	if(optind != (argc - 1)) {
+		usage();
+	}
+
+	unsigned long Tick_Length = 0;
+	byte Initial_Inputs = 0;
+	std::vector<replay_record_t> Records;
+	std::vector<replay_line_t> Expected;
+	if(!readTrace(argv[optind], &Tick_Length, &Initial_Inputs, &Records, &Expected)) {
+		return 2;
+	}
+	if(Baseline_Path != NULL) {
+		Expected.clear();
+		if(!readBaseline(Baseline_Path, &Expected)) {
+			return 2;
+		}
+	}
+
+	// Replay
+	clock_t Wall_Start = clock();
+	setInputs(Initial_Inputs);
+	mockRunTimers(true);
+	setup();
+	collectOutput();
+
+	// Ticks are the Timer0 compare B interrupt, a quarter of the way through each Timer0 period
+	unsigned long Lost_Records = 0;
+	unsigned long Tick = ((((micros() / Tick_Length) + 1) * Tick_Length) + (Tick_Length / 4));
+	unsigned long Time = Tick;
+	for(size_t i = 0; i < Records.size(); i++) {
+		Tick += (Records[i].ticks * Tick_Length);
+		unsigned long Record_Time = (Tick + Records[i].offset);
+		replayRecord(Records[i], Time, Record_Time);
+		Time = Record_Time;
+		Lost_Records += Records[i].lost;
+	}
+	runUntil(Time + (End_Time * 1000));
+	double Wall_Time = ((double) (clock() - Wall_Start) / CLOCKS_PER_SEC);
+
+	// Report
+	if(Output_Path != NULL) {
+		FILE *File = fopen(Output_Path, "w");
+		if(File == NULL) {
+			perror(Output_Path);
+			return 2;
+		}
+		for(size_t i = 0; i < Replay_Output.size(); i++) {
+			fprintf(File, "%lu %s\n", Replay_Output[i].time, Replay_Output[i].text.c_str());
+		}
+		fclose(File);
+	}
+
+	// State changes are only compared with a baseline, as the firmware doesn't print them
+	std::vector<replay_line_t> Replayed;
+	for(size_t i = 0; i < Replay_Output.size(); i++) {
+		if((Baseline_Path != NULL) || (Replay_Output[i].text.compare(0, 2, "= ") != 0)) {
+			Replayed.push_back(Replay_Output[i]);
+		}
+	}
+	unsigned long Differences = compareOutput(Expected, Replayed, Tolerance);
+
+	double Replay_Time = (micros() / 1e6);
+	printf("\nREPLAYED %lu RECORDS (%.1f s) IN %.2f s (%.0fx)\n", (unsigned long) Records.size(), Replay_Time, Wall_Time, Replay_Time / ((Wall_Time > 0) ? Wall_Time : 1e-9));
+	if(Lost_Records > 0) {
+		printf("%lu RECORDS FOLLOW LOST CHANGES; TIMING NEAR THEM IS APPROXIMATE\n", Lost_Records);
+	}
+	printf("%lu DIFFERENCES FROM THE %s\n", Differences, ((Baseline_Path != NULL) ? "BASELINE" : "RECORDING"));
+	return ((Differences > 0) ? 1 : 0);
+}
@@ -0,0 +1,44 @@
+#include "test.h"
+#include "analog.h"
+
+// Time for every channel to publish a complete average, with a conversion to spare
+// Each conversion takes 13 ADC clocks at 125 kHz, or 104 us
+const unsigned long ANALOG_CYCLE_TIME = ((ANALOG_CHANNELS * (ANALOG_AVERAGE_SAMPLES + 2) * 104UL) / 1000) + 1;
+
+TEST(analog_reads_zero_until_converted) {
+	mockSetAnalog(GRAB_SENSE_CHANNEL, 700);
+	initAnalog();
+	CHECK_EQUAL(0, getAnalogValue(ANALOG_GRAB));
+	CHECK_EQUAL(0, getAnalogValue(ANALOG_SUPPLY));
+}
+
+TEST(analog_averages_each_channel) {
+	mockSetAnalog(GRAB_SENSE_CHANNEL, 700);
+	mockSetAnalog(SUPPLY_SENSE_CHANNEL, 300);
+	initAnalog();
+	waitFor(ANALOG_CYCLE_TIME);
+	CHECK_EQUAL(700, getAnalogValue(ANALOG_GRAB));
+	CHECK_EQUAL(300, getAnalogValue(ANALOG_SUPPLY));
+}
+
+TEST(analog_discards_conversion_after_switching_channel) {
+	mockSetAnalog(GRAB_SENSE_CHANNEL, 1023);
+	initAnalog();
+	waitFor(ANALOG_CYCLE_TIME);
+
+	// A conversion of the previous channel would raise the averages of the others
+	for(int Cycle = 0; Cycle < 10; Cycle++) {
+		waitFor(ANALOG_CYCLE_TIME);
+		CHECK_EQUAL(1023, getAnalogValue(ANALOG_GRAB));
+		CHECK_EQUAL(0, getAnalogValue(ANALOG_SUPPLY));
+	}
+}
+
+TEST(analog_follows_input_changes) {
+	mockSetAnalog(SUPPLY_SENSE_CHANNEL, 400);
+	initAnalog();
+	waitFor(ANALOG_CYCLE_TIME);
+	mockSetAnalog(SUPPLY_SENSE_CHANNEL, 800);
+	waitFor(2 * ANALOG_CYCLE_TIME);
+	CHECK_EQUAL(800, getAnalogValue(ANALOG_SUPPLY));
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include "test.h"
+#include "capture.h"
+
+extern encoder_data_t Encoder_Data;
+
+// Takes one sample, moving the encoder beforehand
+void takeSample(int32_t movement) {
+	Encoder_Data.position += movement;
+	for(byte Interrupt = 0; Interrupt < CAPTURE_DIVIDER; Interrupt++) {
+		mockInterrupt(TIMER0_COMPA_vect);
+	}
+}
+
+// Samples until the capture is done, moving the encoder before each sample
+void finishCapture(capture_trigger_t trigger, int32_t movement) {
+	triggerCapture(trigger);
+	for(byte Sample = 0; Sample < CAPTURE_POST_SAMPLES; Sample++) {
+		CHECK(!captureReady());
+		takeSample(movement);
+	}
+	CHECK(captureReady());
+}
+
+// Reconstructs the position of the last sample of the last dump, counting its samples
+int32_t lastDumpPos(int *samples) {
+	size_t Start = Serial.output.rfind("CAPTURE ");
+	CHECK(Start != std::string::npos);
+	const char *Text = Serial.output.c_str() + Start;
+	int Trigger, Count, Trigger_Sample;
+	long Period, Position;
+	CHECK_EQUAL(5, sscanf(Text, "CAPTURE %d %d %d %ld %ld", &Trigger, &Count, &Trigger_Sample, &Period, &Position));
+	for(int Sample = 0; Sample < Count; Sample++) {
+		Text = strchr(Text, '\n') + 1;
+		Position += strtol(Text, NULL, 10);
+	}
+	CHECK(strncmp(strchr(Text, '\n') + 1, "END\n", 4) == 0);
+	*samples = Count;
+	return Position;
+}
+
+TEST(capture_reconstructs_position) {
+	Encoder_Data.position = 1000;
+	initCapture();
+	for(int Sample = 0; Sample < 10; Sample++) {
+		takeSample(7);
+	}
+	finishCapture(CAPTURE_OVERSHOOT, -3);
+	dumpCapture();
+	int Samples;
+	CHECK_EQUAL(getEncoderPos(), lastDumpPos(&Samples));
+	CHECK_EQUAL(10 + CAPTURE_POST_SAMPLES, Samples);
+	CHECK(!captureReady());
+}
+
+TEST(capture_keeps_oldest_samples_in_base_position) {
+	initCapture();
+	for(int Sample = 0; Sample < (3 * CAPTURE_SAMPLES); Sample++) {
+		takeSample(Sample);
+	}
+	finishCapture(CAPTURE_WATCHDOG, 100);
+	dumpCapture();
+	int Samples;
+	CHECK_EQUAL(getEncoderPos(), lastDumpPos(&Samples));
+	CHECK_EQUAL(CAPTURE_SAMPLES, Samples);
+}
+
+TEST(capture_rearms_at_current_position) {
+	initCapture();
+	finishCapture(CAPTURE_WATCHDOG, 100);
+	dumpCapture();
+
+	// Motion while a capture waits to be dumped isn't sampled, and must not appear in the next one
+	finishCapture(CAPTURE_WATCHDOG, 500);
+	Encoder_Data.position += 55000;
+	dumpCapture();
+	takeSample(-20000);
+	finishCapture(CAPTURE_OVERSHOOT, -100);
+	dumpCapture();
+	int Samples;
+	CHECK_EQUAL(getEncoderPos(), lastDumpPos(&Samples));
+	CHECK_EQUAL(1 + CAPTURE_POST_SAMPLES, Samples);
+}
+
+TEST(capture_state_trigger_leaves_capture_armed_for_faults) {
+	initCapture();
+	triggerCapture(CAPTURE_STATE);
+	for(int Sample = 0; Sample < CAPTURE_SAMPLES; Sample++) {
+		takeSample(10);
+	}
+	CHECK(!captureReady());
+	finishCapture(CAPTURE_OVERSHOOT, -10);
+	dumpCapture();
+	CHECK(Serial.output.find("CAPTURE 2 ") != std::string::npos);
+}
@@ -0,0 +1,154 @@
+#include "test.h"
+#include "safety-encoder.h"
+#include "host-asm.h"
+
+extern encoder_data_t Encoder_Data;
+
+// Pin states in order of positive movement, as (pin1 << 1) | pin0
+const byte QUADRATURE_SEQUENCE[4] = {0b00, 0b10, 0b11, 0b01};
+
+byte quadraturePhase(byte pins) {
+	for(byte Phase = 0; Phase < 4; Phase++) {
+		if(QUADRATURE_SEQUENCE[Phase] == pins) {
+			return Phase;
+		}
+	}
+	return 0;
+}
+
+// Position change of a single step between adjacent pin states
+int quadratureStep(byte from, byte to) {
+	switch((quadraturePhase(to) - quadraturePhase(from)) & 0x03) {
+		case 1:
+			return 1;
+		case 3:
+			return -1;
+		default:
+			return 0;
+	}
+}
+
+// Position change seen by an interrupt, assuming its own pin changed first if both pins changed
+int quadratureDelta(byte from, byte to, byte interrupt) {
+	if((from ^ to) != 0b11) {
+		return quadratureStep(from, to);
+	}
+	byte Between = (from ^ (1 << interrupt));
+	return (quadratureStep(from, Between) + quadratureStep(Between, to));
+}
+
+void setEncoderPins(byte pins) {
+	mockSetPin(ENC_A_PIN, (pins & 0b01) ? HIGH : LOW);
+	mockSetPin(ENC_B_PIN, (pins & 0b10) ? HIGH : LOW);
+	return;
+}
+
+void startEncoderAt(byte pins) {
+	setEncoderPins(pins);
+	initEncoder();
+	startEncoder();
+	return;
+}
+
+void runEncoderInterrupt(byte interrupt) {
+	checkTrue(mockInterrupt((interrupt == 0) ? INT0_vect : INT1_vect), "interrupts left disabled", __FILE__, __LINE__);
+	return;
+}
+
+// Checks every transition of both interrupts against the quadrature model, from a start position
+void checkAllTransitions(int32_t start) {
+	for(byte Interrupt = 0; Interrupt < 2; Interrupt++) {
+		for(byte From = 0; From < 4; From++) {
+			for(byte To = 0; To < 4; To++) {
+				startEncoderAt(From);
+				Encoder_Data.position = start;
+				setEncoderPins(To);
+				runEncoderInterrupt(Interrupt);
+				CHECK_EQUAL(To, Encoder_Data.state);
+				CHECK_EQUAL((int32_t) (start + quadratureDelta(From, To, Interrupt)), getEncoderPos());
+				bool Skipped = ((From ^ To) == 0b11);
+				CHECK_EQUAL((Interrupt == 0) && Skipped, getEncoderSkipped(0));
+				CHECK_EQUAL((Interrupt == 1) && Skipped, getEncoderSkipped(1));
+			}
+		}
+	}
+	return;
+}
+
+TEST(encoder_model_matches_documented_table) {
+	// INT0 and INT1 only differ where both pins changed
+	CHECK_EQUAL(-2, quadratureDelta(0b11, 0b00, 0));
+	CHECK_EQUAL(2, quadratureDelta(0b11, 0b00, 1));
+	CHECK_EQUAL(2, quadratureDelta(0b10, 0b01, 0));
+	CHECK_EQUAL(-2, quadratureDelta(0b10, 0b01, 1));
+	CHECK_EQUAL(1, quadratureDelta(0b01, 0b00, 0));
+	CHECK_EQUAL(-1, quadratureDelta(0b00, 0b01, 1));
+}
+
+TEST(encoder_start_reads_pins) {
+	startEncoderAt(0b10);
+	CHECK_EQUAL(0b10, Encoder_Data.state);
+	CHECK_EQUAL(0, getEncoderPos());
+	CHECK_EQUAL((1 << INT1) | (1 << INT0), EIMSK);
+}
+
+TEST(encoder_decodes_every_transition) {
+	checkAllTransitions(1000);
+}
+
+TEST(encoder_carries_across_bytes) {
+	checkAllTransitions(0);
+	checkAllTransitions(-1);
+	checkAllTransitions(0xFF);
+	checkAllTransitions(0xFFFF);
+	checkAllTransitions(0x00FFFFFF);
+	checkAllTransitions(INT32_MAX);
+}
+
+TEST(encoder_jump_table_works_at_any_address) {
+	// The table may straddle a 256-word boundary, which needs the carry into the high byte
+	for(uint16_t Base = 0x00F0; Base <= 0x0100; Base++) {
+		setHostAsmBase(Base);
+		checkAllTransitions(1000);
+	}
+}
+
+TEST(encoder_follows_random_walk) {
+	startEncoderAt(0b00);
+	srand(1);
+	byte Pins = 0b00;
+	long Expected = 0;
+	byte Expected_Skipped[2] = {0, 0};
+	for(int Step = 0; Step < 100000; Step++) {
+		byte Interrupt = (rand() & 0x01);
+		byte Next = (Pins ^ (1 << Interrupt));
+
+		// Occasionally miss the edge of the other pin
+		if((rand() % 50) == 0) {
+			Next ^= (1 << (1 - Interrupt));
+			Expected_Skipped[Interrupt] += 1;
+		}
+		Expected += quadratureDelta(Pins, Next, Interrupt);
+		setEncoderPins(Next);
+		runEncoderInterrupt(Interrupt);
+		Pins = Next;
+	}
+	CHECK_EQUAL(Expected, getEncoderPos());
+	CHECK_EQUAL(Expected_Skipped[0], getEncoderSkipped(0));
+	CHECK_EQUAL(Expected_Skipped[1], getEncoderSkipped(1));
+}
+
+TEST(encoder_counts_full_turns) {
+	startEncoderAt(0b00);
+	for(int Turn = 0; Turn < 1000; Turn++) {
+		for(byte Phase = 1; Phase <= 4; Phase++) {
+			byte Pins = QUADRATURE_SEQUENCE[Phase & 0x03];
+			byte Interrupt = ((Pins ^ Encoder_Data.state) == 0b01) ? 0 : 1;
+			setEncoderPins(Pins);
+			runEncoderInterrupt(Interrupt);
+		}
+	}
+	CHECK_EQUAL(4000, getEncoderPos());
+	homeEncoder();
+	CHECK_EQUAL(0, getEncoderPos());
+}
@@ -0,0 +1,119 @@
+#include "test.h"
+#include "safety-error.h"
+
+typedef struct {
+	unsigned long on;   // Milliseconds
+	unsigned long off;  // Milliseconds
+} blink_t;
+
+// Runs the error code display every millisecond, and returns each blink of the status LED
+std::vector<blink_t> runErrorDisplay(unsigned long ms) {
+	mockClearPinWrites();
+	for(unsigned long Time = 0; Time <= ms; Time++) {
+		mockSetMicros(Time * 1000);
+		handleErrorCodeDisplay();
+	}
+
+	std::vector<blink_t> Blinks;
+	uint8_t Level = LOW;
+	size_t Count;
+	const mock_pin_write_t *Writes = mockPinWrites(&Count);
+	for(size_t i = 0; i < Count; i++) {
+		if((Writes[i].pin != ERROR_PIN) || (Writes[i].value == Level)) {
+			continue;
+		}
+		Level = Writes[i].value;
+		if(Level == HIGH) {
+			blink_t Blink = {Writes[i].time / 1000, 0};
+			Blinks.push_back(Blink);
+		}
+		else {
+			Blinks.back().off = Writes[i].time / 1000;
+		}
+	}
+	return Blinks;
+}
+
+TEST(blinks_next_cycles_through_active_errors) {
+	initErrors();
+	CHECK_EQUAL(0, getBlinksNext(0));
+	flagError(2);
+	flagError(5);
+	CHECK_EQUAL(2, getBlinksNext(0));
+	CHECK_EQUAL(5, getBlinksNext(2));
+	CHECK_EQUAL(5, getBlinksNext(4));
+	CHECK_EQUAL(2, getBlinksNext(5));
+	CHECK_EQUAL(2, getBlinksNext(ERROR_CODES));
+	CHECK_EQUAL(2, getBlinksNext(255));
+	clearErrors();
+	CHECK_EQUAL(0, getBlinksNext(2));
+}
+
+TEST(blinks_next_handles_highest_error) {
+	initErrors();
+	flagError(ERROR_CODES);
+	CHECK_EQUAL(ERROR_CODES, getBlinksNext(0));
+	CHECK_EQUAL(ERROR_CODES, getBlinksNext(ERROR_CODES));
+	flagError(0);
+	flagError(ERROR_CODES + 1);
+	CHECK_EQUAL(ERROR_CODES, getBlinksNext(1));
+}
+
+TEST(blink_digits_never_show_zero) {
+	byte Digits[ERROR_DIGITS];
+	CHECK_EQUAL(1, getBlinkDigits(ERROR_DIGIT_MAX, Digits));
+	CHECK_EQUAL(ERROR_DIGIT_MAX, Digits[0]);
+	for(byte Error = 1; Error <= ERROR_CODES; Error++) {
+		byte Count = getBlinkDigits(Error, Digits);
+		unsigned int Value = 0;
+		for(byte Digit = 0; Digit < Count; Digit++) {
+			CHECK((Digits[Digit] >= 1) && (Digits[Digit] <= ERROR_DIGIT_MAX));
+			Value = (Value * ERROR_DIGIT_MAX) + Digits[Digit];
+		}
+		CHECK_EQUAL(Error, Value);
+	}
+}
+
+TEST(error_display_blinks_single_digit_code) {
+	initErrors();
+	flagError(2);
+	std::vector<blink_t> Blinks = runErrorDisplay(6000);
+
+	// The blank cycle running at startup ends first
+	const unsigned long Cycle = (ERROR_DIGIT_TICKS + ERROR_CODE_GAP_TICKS) * ERROR_TICK_TIME;
+	CHECK_EQUAL(6, Blinks.size());
+	for(size_t i = 0; i < Blinks.size(); i++) {
+		unsigned long Expected_On = (Cycle * (1 + (i / 2))) + ((i % 2) * ERROR_TICK_TIME);
+		CHECK(abs((long) (Blinks[i].on - Expected_On)) <= 1);
+		CHECK(abs((long) (Blinks[i].off - Blinks[i].on - ERROR_BLINK_TIME)) <= 1);
+	}
+}
+
+TEST(error_display_blinks_each_digit) {
+	initErrors();
+	flagError(6);
+	std::vector<blink_t> Blinks = runErrorDisplay(4700);
+
+	// 6 is shown as 1 blink, then 2 blinks
+	const unsigned long Start = (ERROR_DIGIT_TICKS + ERROR_CODE_GAP_TICKS) * ERROR_TICK_TIME;
+	const unsigned long Offsets[] = {0, 5, 6};
+	CHECK_EQUAL(3, Blinks.size());
+	for(size_t i = 0; i < Blinks.size(); i++) {
+		CHECK(abs((long) (Blinks[i].on - (Start + (Offsets[i] * ERROR_TICK_TIME)))) <= 1);
+	}
+}
+
+TEST(error_display_stays_off_without_errors) {
+	initErrors();
+	CHECK_EQUAL(0, runErrorDisplay(5000).size());
+}
+
+TEST(flag_error_restores_interrupt_state) {
+	initErrors();
+	noInterrupts();
+	flagError(1);
+	CHECK(!(SREG & (1 << SREG_I)));
+	interrupts();
+	flagError(1);
+	CHECK(SREG & (1 << SREG_I));
+}
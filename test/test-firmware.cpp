@@ -0,0 +1,152 @@
+#include "test.h"
+#include "../CML-Firmware.h"
+
+extern encoder_data_t Encoder_Data;
+
+void setup();
+
+TEST(boot_at_home_is_ready_without_moving) {
+	setup();
+
+	// The encoder is started by loop() once its pins have settled, and startup is then reported
+	CHECK_EQUAL(0, EIMSK);
+	CHECK(Serial.output.find("BOOT (us): ") == std::string::npos);
+	runFor(100);
+	CHECK_EQUAL(((1 << INT1) | (1 << INT0)), EIMSK);
+	CHECK(Serial.output.find("BOOT (us): SERIAL ") != std::string::npos);
+	CHECK(!motorEnabled());
+	CHECK_EQUAL(LOW, mockGetPin(MOTOR_DIR_PIN));
+	CHECK(Serial.output.find("READY: ") != std::string::npos);
+	CHECK(Serial.output.find(" ms, BOOT REPORTED: ") != std::string::npos);
+}
+
+TEST(boot_homes_to_endstop) {
+	mockSetPin(ENDSTOP_0_PIN, LOW);
+	setup();
+
+	// The relay was switched during startup, so homing can start once it settles
+	CHECK_EQUAL(HIGH, mockGetPin(MOTOR_DIR_PIN));
+	for(int Step = 0; Step < 50; Step++) {
+		runFor(10);
+		Encoder_Data.position -= 200;
+	}
+	CHECK(motorEnabled());
+	CHECK(!isFaulted());
+	CHECK(Serial.output.find("READY: ") == std::string::npos);
+
+	mockSetPin(ENDSTOP_0_PIN, HIGH);
+	runFor(100);
+	CHECK(!motorEnabled());
+	CHECK_EQUAL(0, getEncoderPos());
+	CHECK(Serial.output.find("READY: ") != std::string::npos);
+}
+
+TEST(stalled_homing_starts_recovery) {
+	mockSetPin(ENDSTOP_0_PIN, LOW);
+	setup();
+	runFor(500);
+	CHECK(Serial.output.find("WATCHDOG ERROR @ ") != std::string::npos);
+	CHECK(Serial.output.find("RECOVERY 1 FROM STATE 0") != std::string::npos);
+}
+
+extern state_t Current_State;
+extern unsigned long State_Start;
+
+// Runs until the state machine reaches a state, moving the bucket while the motor runs
+void runUntilState(state_t state) {
+	for(int Step = 0; (Step < 2000) && (Current_State != state); Step++) {
+		runFor(2);
+		if(motorEnabled()) {
+			Encoder_Data.position += ((mockGetPin(MOTOR_DIR_PIN) == HIGH) ? -200 : 200);
+		}
+	}
+	CHECK_EQUAL(state, Current_State);
+}
+
+// Boots at home and starts a cycle, running until the bucket dwells at its travel target
+void runToGrab() {
+	setup();
+	runFor(100);
+	mockSetPin(GO_PIN, LOW);
+	runFor(10);
+	mockSetPin(GO_PIN, HIGH);
+	runUntilState(DOWN);
+	mockSetPin(ENDSTOP_0_PIN, LOW);
+	runUntilState(GRAB);
+	CHECK(magnetEnabled());
+}
+
+// Time from the start of the dwell to returning home, which first waits for the relay to switch
+unsigned long timeGrab() {
+	unsigned long Start = State_Start;
+	runUntilState(UP);
+	return (millis() - Start - MOTOR_RELAY_CHANGE_DELAY);
+}
+
+TEST(grab_ends_early_once_load_is_confirmed) {
+	runToGrab();
+	mockSetAnalog(GRAB_SENSE_CHANNEL, GRAB_LOAD_THRESHOLD);
+
+	// The load is confirmed at once, but the magnet is given MAGNET_GRAB_DELAY to grab
+	unsigned long Dwell = timeGrab();
+	CHECK(Dwell >= MAGNET_GRAB_DELAY);
+	CHECK(Dwell < (MAGNET_GRAB_DELAY + 10));
+	CHECK(magnetEnabled());
+}
+
+TEST(grab_without_load_waits_for_dwell) {
+	runToGrab();
+	mockSetAnalog(GRAB_SENSE_CHANNEL, GRAB_LOAD_THRESHOLD - 1);
+	unsigned long Dwell = timeGrab();
+	CHECK(Dwell >= MOTOR_GRAB_DELAY);
+	CHECK(Dwell < (MOTOR_GRAB_DELAY + 10));
+	CHECK(!isFaulted());
+}
+
+// Stalls homing until it faults, then lets the motor move, with the endstop below position 0
+void runRecovery(unsigned long ms) {
+	for(unsigned long Step = 0; Step < (ms / 2); Step++) {
+		runFor(2);
+		if(motorEnabled()) {
+			Encoder_Data.position += ((mockGetPin(MOTOR_DIR_PIN) == HIGH) ? -200 : 200);
+		}
+		mockSetPin(ENDSTOP_0_PIN, (getEncoderPos() < 0) ? HIGH : LOW);
+	}
+}
+
+TEST(recovery_attempts_are_recorded) {
+	mockSetPin(ENDSTOP_0_PIN, LOW);
+	setup();
+	runFor(500);
+	Serial.input = "R";
+	runFor(10);
+	CHECK(Serial.output.find("RECOVERIES x1\nRECOVERY 1 FROM STATE 0 AT: ") != std::string::npos);
+	CHECK(Serial.output.find(" @ POS: 0 WAIT: 2000 PENDING\n") != std::string::npos);
+
+	runRecovery(4000);
+	CHECK_EQUAL(IDLE, Current_State);
+	Serial.output.clear();
+	Serial.input = "r";
+	runFor(10);
+	CHECK(Serial.output.find("RECOVERIES x1\n") != std::string::npos);
+	CHECK(Serial.output.find(" WAIT: 2000 RECOVERED\n") != std::string::npos);
+}
+
+TEST(recovery_records_faults_and_cancellation) {
+	mockSetPin(ENDSTOP_0_PIN, LOW);
+	setup();
+
+	// Stalling again while reversing faults the first attempt, and starts another
+	runFor(500);
+	runFor(RECOVERY_BACKOFF_DELAY + 500);
+	mockSetPin(BACK_PIN, LOW);
+	runFor(10);
+	mockSetPin(BACK_PIN, HIGH);
+	Serial.output.clear();
+	Serial.input = "R";
+	runFor(10);
+	CHECK(Serial.output.find("RECOVERIES x2\n") != std::string::npos);
+	CHECK(Serial.output.find("RECOVERY 1 FROM STATE 0 ") != std::string::npos);
+	CHECK(Serial.output.find(" WAIT: 2000 FAULTED\nRECOVERY 2 FROM STATE 6 ") != std::string::npos);
+	CHECK(Serial.output.find(" WAIT: 4000 CANCELLED\n") != std::string::npos);
+}
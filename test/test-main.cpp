@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <vector>
+#include "test.h"
+
+void loop();
+
+typedef struct {
+	const char *name;
+	void (*test)();
+} test_t;
+
+std::vector<test_t> &getTests() {
+	static std::vector<test_t> Tests;
+	return Tests;
+}
+
+TestRegistration::TestRegistration(const char *name, void (*test)()) {
+	test_t Test = {name, test};
+	getTests().push_back(Test);
+}
+
+void checkTrue(bool condition, const char *text, const char *file, int line) {
+	if(!condition) {
+		fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, text);
+		exit(1);
+	}
+	return;
+}
+
+void checkEqual(long expected, long actual, const char *text, const char *file, int line) {
+	if(expected != actual) {
+		fprintf(stderr, "%s:%d: %s is %ld, expected %ld\n", file, line, text, actual, expected);
+		exit(1);
+	}
+	return;
+}
+
+void runFor(unsigned long ms) {
+	mockRunTimers(true);
+	unsigned long Start = micros();
+	while((micros() - Start) < (ms * 1000)) {
+		loop();
+	}
+	mockRunTimers(false);
+	return;
+}
+
+void waitFor(unsigned long ms) {
+	mockRunTimers(true);
+	delay(ms);
+	mockRunTimers(false);
+	return;
+}
+
+bool runTest(const test_t &test) {
+	fflush(stdout);
+	pid_t Child = fork();
+	if(Child == 0) {
+		alarm(TEST_TIMEOUT);
+		test.test();
+		exit(0);
+	}
+	int Status;
+	waitpid(Child, &Status, 0);
+	if(WIFSIGNALED(Status)) {
+		fprintf(stderr, "%s: killed by signal %d%s\n", test.name, WTERMSIG(Status), ((WTERMSIG(Status) == SIGALRM) ? " (timed out)" : ""));
+	}
+	return (WIFEXITED(Status) && (WEXITSTATUS(Status) == 0));
+}
+
+int main(int argc, char *argv[]) {
+	int Run = 0;
+	int Failed = 0;
+	std::vector<test_t> &Tests = getTests();
+	for(size_t i = 0; i < Tests.size(); i++) {
+		bool Selected = (argc < 2);
+		for(int Arg = 1; Arg < argc; Arg++) {
+			Selected |= (strcmp(argv[Arg], Tests[i].name) == 0);
+		}
+		if(!Selected) {
+			continue;
+		}
+		bool Passed = runTest(Tests[i]);
+		printf("%-48s %s\n", Tests[i].name, (Passed ? "PASS" : "FAIL"));
+		Run += 1;
+		Failed += !Passed;
+	}
+	printf("\n%d of %d tests passed\n", Run - Failed, Run);
+	return ((Failed > 0) ? 1 : 0);
+}
@@ -0,0 +1,220 @@
+#include "test.h"
+#include "power.h"
+
+extern volatile uint16_t Motor_Duty;
+extern volatile uint16_t Motor_Target;
+extern bool Watchdog_Enabled;
+
+// Delays are timed with millis(), so may end up to a millisecond early
+const unsigned long FLYBACK_MIN = (MOTOR_FLYBACK_DELAY - 1) * 1000UL;
+const unsigned long RELAY_CHANGE_MIN = (MOTOR_RELAY_CHANGE_DELAY - 1) * 1000UL;
+
+// Returns the time of the last write to a pin, in microseconds
+unsigned long lastPinWrite(uint8_t pin, uint8_t value) {
+	size_t Count;
+	const mock_pin_write_t *Writes = mockPinWrites(&Count);
+	for(size_t i = Count; i > 0; i--) {
+		if((Writes[i - 1].pin == pin) && (Writes[i - 1].value == value)) {
+			return Writes[i - 1].time;
+		}
+	}
+	checkTrue(false, "pin written", __FILE__, __LINE__);
+	return 0;
+}
+
+TEST(halt_at_boot_does_not_wait) {
+	initPowerOutputs();
+	prepareMotorOutput(BACKWARD);
+	CHECK_EQUAL(HIGH, mockGetPin(MOTOR_DIR_PIN));
+
+	// The motor has never run, so there is nothing to discharge
+	unsigned long Start = micros();
+	setMotorOutput(HALT);
+	CHECK(micros() - Start < 1000);
+	CHECK_EQUAL(LOW, mockGetPin(MOTOR_DIR_PIN));
+}
+
+TEST(first_movement_waits_for_relay_only) {
+	initPowerOutputs();
+	setMotorSpeed(SLOW);
+	prepareMotorOutput(BACKWARD);
+	unsigned long Relay_Time = lastPinWrite(MOTOR_DIR_PIN, HIGH);
+	setMotorOutput(BACKWARD);
+	CHECK(micros() - Relay_Time >= RELAY_CHANGE_MIN);
+	CHECK(micros() - Relay_Time < (MOTOR_RELAY_CHANGE_DELAY + 1) * 1000UL);
+	CHECK(motorEnabled());
+	CHECK(Watchdog_Enabled);
+	CHECK_EQUAL(PWM_SPEED_SLOW, Motor_Target);
+}
+
+TEST(reversal_discharges_then_switches_relay) {
+	initPowerOutputs();
+	setMotorSpeed(MEDIUM);
+	setMotorOutput(FORWARD);
+	mockAdvance(1000000);
+	mockClearPinWrites();
+
+	unsigned long Start = micros();
+	setMotorOutput(BACKWARD);
+	unsigned long Relay_Time = lastPinWrite(MOTOR_DIR_PIN, HIGH);
+	CHECK(Relay_Time - Start >= FLYBACK_MIN);
+	CHECK(Relay_Time - Start < (MOTOR_FLYBACK_DELAY + 1) * 1000UL);
+	CHECK(micros() - Relay_Time >= RELAY_CHANGE_MIN);
+
+	// The duty cycle was dropped before the wait, and slews back up from 0 afterward
+	CHECK_EQUAL(0, OCR1A);
+	CHECK_EQUAL(0, Motor_Duty);
+	CHECK_EQUAL(PWM_SPEED_MEDIUM, Motor_Target);
+	CHECK(TIMSK1 & (1 << TOIE1));
+	for(uint16_t Cycle = 1; Cycle <= PWM_SPEED_MEDIUM; Cycle++) {
+		CHECK(mockInterrupt(TIMER1_OVF_vect));
+		CHECK_EQUAL(Cycle * PWM_MOTOR_SLEW, OCR1A);
+	}
+	CHECK_EQUAL(0, TIMSK1);
+	CHECK(motorDutySettled());
+}
+
+TEST(halt_returns_relay_after_discharge) {
+	initPowerOutputs();
+	setMotorOutput(BACKWARD);
+	mockAdvance(1000000);
+	mockClearPinWrites();
+
+	unsigned long Start = micros();
+	setMotorOutput(HALT);
+	CHECK_EQUAL(0, Motor_Target);
+	CHECK(!Watchdog_Enabled);
+	CHECK(!motorEnabled());
+	CHECK(lastPinWrite(MOTOR_DIR_PIN, LOW) - Start >= FLYBACK_MIN);
+	CHECK(!motorOutputReady());
+	mockAdvance(MOTOR_RELAY_CHANGE_DELAY * 1000UL);
+	CHECK(motorOutputReady());
+}
+
+TEST(prepared_movement_does_not_block) {
+	initPowerOutputs();
+	setMotorOutput(FORWARD);
+	setMotorOutput(HALT);
+	prepareMotorOutput(BACKWARD);
+	CHECK_EQUAL(HIGH, mockGetPin(MOTOR_DIR_PIN));
+	while(!motorOutputReady()) {
+		// Let the relay settle
+	}
+	unsigned long Start = micros();
+	setMotorOutput(BACKWARD);
+	CHECK(micros() - Start < 1000);
+}
+
+TEST(stop_does_not_block_with_interrupts_disabled) {
+	initPowerOutputs();
+	setMotorOutput(BACKWARD);
+	noInterrupts();
+	stopMotorOutput();
+	interrupts();
+	CHECK(!motorEnabled());
+	CHECK_EQUAL(0, OCR1A);
+	CHECK(!Watchdog_Enabled);
+
+	// The relay is left backward until the next movement
+	CHECK_EQUAL(HIGH, mockGetPin(MOTOR_DIR_PIN));
+	setMotorOutput(HALT);
+	CHECK_EQUAL(LOW, mockGetPin(MOTOR_DIR_PIN));
+}
+
+TEST(slew_duty_steps_toward_target) {
+	CHECK_EQUAL(5, slewDuty(4, 10, 1));
+	CHECK_EQUAL(10, slewDuty(8, 10, 5));
+	CHECK_EQUAL(7, slewDuty(10, 4, 3));
+	CHECK_EQUAL(4, slewDuty(5, 4, 3));
+	CHECK_EQUAL(10, slewDuty(0, 10, 0));
+}
+
+extern volatile uint16_t Error_Mask;
+
+// Sets the supply voltage, and waits for it to be sampled
+void setSupply(unsigned long mv) {
+	mockSetAnalog(SUPPLY_SENSE_CHANNEL, (((mv << 10) + (SUPPLY_FULL_SCALE_MV / 2)) / SUPPLY_FULL_SCALE_MV));
+	waitFor(5);
+	CHECK(abs((long) getSupplyVoltage() - (long) mv) < 25);
+}
+
+// Counts the low supply warnings printed
+int countSupplyWarnings() {
+	int Count = 0;
+	for(size_t Found = Serial.output.find("LOW SUPPLY: "); Found != std::string::npos; Found = Serial.output.find("LOW SUPPLY: ", Found + 1)) {
+		Count += 1;
+	}
+	return Count;
+}
+
+TEST(supply_compensation_scales_duty) {
+	initAnalog();
+	setSupply(SUPPLY_NOMINAL_MV);
+	CHECK(abs((long) compensateDuty(PWM_SPEED_SLOW) - (long) PWM_SPEED_SLOW) <= 1);
+
+	// A higher supply gives a proportionally lower duty cycle, and a lower one a higher duty cycle
+	setSupply(2 * SUPPLY_NOMINAL_MV);
+	CHECK_EQUAL((PWM_SPEED_MEDIUM * (unsigned long) SUPPLY_NOMINAL_MV) / getSupplyVoltage(), compensateDuty(PWM_SPEED_MEDIUM));
+	setSupply(10000);
+	CHECK_EQUAL((PWM_SPEED_SLOW * (unsigned long) SUPPLY_NOMINAL_MV) / getSupplyVoltage(), compensateDuty(PWM_SPEED_SLOW));
+	CHECK(compensateDuty(PWM_SPEED_SLOW) > PWM_SPEED_SLOW);
+}
+
+TEST(supply_compensation_clamps_at_pwm_top) {
+	initAnalog();
+	setSupply(SUPPLY_NOMINAL_MV / 2);
+	CHECK_EQUAL(PWM_TOP, compensateDuty(PWM_SPEED_FAST));
+	CHECK_EQUAL(PWM_TOP, compensateDuty(PWM_SPEED_MEDIUM));
+	CHECK_EQUAL((PWM_SPEED_SLOW * (unsigned long) SUPPLY_NOMINAL_MV) / getSupplyVoltage(), compensateDuty(PWM_SPEED_SLOW));
+}
+
+TEST(supply_compensation_ignores_invalid_readings) {
+	initAnalog();
+	CHECK_EQUAL(PWM_SPEED_MEDIUM, compensateDuty(PWM_SPEED_MEDIUM));
+	setSupply(SUPPLY_MIN_VALID_MV - 200);
+	CHECK_EQUAL(PWM_SPEED_MEDIUM, compensateDuty(PWM_SPEED_MEDIUM));
+	handleSupplyVoltage();
+	CHECK_EQUAL(0, countSupplyWarnings());
+	CHECK(!(Error_Mask & (1 << (5 - 1))));
+}
+
+TEST(supply_compensation_follows_supply_while_moving) {
+	initAnalog();
+	setSupply(SUPPLY_NOMINAL_MV);
+	initPowerOutputs();
+	setMotorSpeed(SLOW);
+	setMotorOutput(FORWARD);
+	CHECK(motorEnabled());
+	uint16_t Nominal_Target = Motor_Target;
+	setSupply(SUPPLY_NOMINAL_MV - 3000);
+	handleSupplyVoltage();
+	CHECK(Motor_Target > Nominal_Target);
+	CHECK_EQUAL(compensateDuty(PWM_SPEED_SLOW), Motor_Target);
+}
+
+TEST(low_supply_flags_error_once_per_drop) {
+	initAnalog();
+	setSupply(SUPPLY_NOMINAL_MV);
+	handleSupplyVoltage();
+	CHECK_EQUAL(0, countSupplyWarnings());
+
+	setSupply(SUPPLY_LOW_MV - 500);
+	for(int Check = 0; Check < 10; Check++) {
+		handleSupplyVoltage();
+	}
+	CHECK_EQUAL(1, countSupplyWarnings());
+	CHECK(Error_Mask & (1 << (5 - 1)));
+
+	// Recovering by less than the hysteresis doesn't count as a new drop
+	setSupply(SUPPLY_LOW_MV + (SUPPLY_LOW_HYSTERESIS_MV / 2));
+	handleSupplyVoltage();
+	setSupply(SUPPLY_LOW_MV - 500);
+	handleSupplyVoltage();
+	CHECK_EQUAL(1, countSupplyWarnings());
+
+	setSupply(SUPPLY_LOW_MV + SUPPLY_LOW_HYSTERESIS_MV + 100);
+	handleSupplyVoltage();
+	setSupply(SUPPLY_LOW_MV - 500);
+	handleSupplyVoltage();
+	CHECK_EQUAL(2, countSupplyWarnings());
+}
@@ -0,0 +1,101 @@
+#include "test.h"
+#include "safety.h"
+
+extern encoder_data_t Encoder_Data;
+extern volatile uint16_t Error_Mask;
+extern volatile uint16_t Motor_Target;
+extern volatile byte Supervisor_Heartbeats;
+
+// Starts the motor with the watchdog watching it
+void startWatchedMotor() {
+	initWatchdog();
+	startEncoder();
+	initPowerOutputs();
+	setMotorOutput(FORWARD);
+	CHECK(motorEnabled());
+}
+
+TEST(watchdog_passes_while_moving) {
+	startWatchedMotor();
+	for(int Cycle = 0; Cycle < 100; Cycle++) {
+		Encoder_Data.position += WATCHDOG_THRESHOLD;
+		CHECK(mockInterrupt(TIMER2_OVF_vect));
+		CHECK(!isFaulted());
+	}
+	CHECK(motorEnabled());
+}
+
+TEST(watchdog_faults_once_stalled_for_watchdog_cycles) {
+	startWatchedMotor();
+	for(int Cycle = 0; Cycle < 10; Cycle++) {
+		Encoder_Data.position += (2 * WATCHDOG_THRESHOLD);
+		mockInterrupt(TIMER2_OVF_vect);
+	}
+
+	// Moving no further than the threshold in WATCHDOG_CYCLES cycles is a stall
+	for(int Cycle = 1; Cycle < WATCHDOG_CYCLES; Cycle++) {
+		Encoder_Data.position += 1;
+		CHECK(mockInterrupt(TIMER2_OVF_vect));
+		CHECK(!isFaulted());
+	}
+	Encoder_Data.position += 1;
+	CHECK(mockInterrupt(TIMER2_OVF_vect));
+	CHECK(isFaulted());
+
+	// The motor is stopped from within the interrupt, without waiting for it to discharge
+	CHECK(!motorEnabled());
+	CHECK_EQUAL(0, Motor_Target);
+	CHECK_EQUAL(0, OCR1A);
+	CHECK(Error_Mask & (1 << (3 - 1)));
+	CHECK(Serial.output.find("WATCHDOG ERROR @ ") != std::string::npos);
+
+	// Only one fault is raised
+	size_t Length = Serial.output.size();
+	for(int Cycle = 0; Cycle < 10; Cycle++) {
+		mockInterrupt(TIMER2_OVF_vect);
+	}
+	CHECK_EQUAL(Length, Serial.output.size());
+}
+
+TEST(watchdog_ignores_disabled_motor) {
+	startWatchedMotor();
+	setMotorOutput(HALT);
+	for(int Cycle = 0; Cycle < 10; Cycle++) {
+		CHECK(mockInterrupt(TIMER2_OVF_vect));
+	}
+	CHECK(!isFaulted());
+}
+
+TEST(timer2_checks_in_with_supervisor) {
+	initWatchdog();
+	initSupervisor();
+	unsigned long Resets = Mock_Wdt_Resets;
+	mockInterrupt(TIMER2_OVF_vect);
+	CHECK_EQUAL(HEARTBEAT_TIMER2, Supervisor_Heartbeats);
+	checkInSupervisor(HEARTBEAT_LOOP);
+	CHECK_EQUAL(0, Supervisor_Heartbeats);
+	CHECK_EQUAL(Resets + 1, Mock_Wdt_Resets);
+}
+
+TEST(check_in_restores_interrupt_state) {
+	noInterrupts();
+	checkInSupervisor(HEARTBEAT_LOOP);
+	CHECK(!(SREG & (1 << SREG_I)));
+	interrupts();
+	checkInSupervisor(HEARTBEAT_LOOP);
+	CHECK(SREG & (1 << SREG_I));
+}
+
+TEST(skip_rate_flags_error_once_over_threshold) {
+	initWatchdog();
+	for(byte Cycle = 0; Cycle < SKIP_WINDOW_CYCLES; Cycle++) {
+		if(Cycle == 0) {
+			Encoder_Data.skipped_int0 += SKIP_RATE_THRESHOLD;
+			Encoder_Data.skipped_int1 += 1;
+		}
+		mockInterrupt(TIMER2_OVF_vect);
+	}
+	CHECK(Error_Mask & (1 << (6 - 1)));
+	printEncoderIntegrity();
+	CHECK(Serial.output.find("SKIPPED INT0: 10 INT1: 1 RATE: 11") != std::string::npos);
+}
@@ -0,0 +1,83 @@
+#include "test.h"
+#include "../CML-Firmware.h"
+
+extern bool Sensor_Engaged[5];
+
+// Starts with every sensor disengaged, with the bucket away from its endstop
+void initOpenInputs() {
+	initInputs();
+	mockSetPin(ENDSTOP_0_PIN, LOW);
+	return;
+}
+
+TEST(sensor_engages_after_required_count) {
+	initOpenInputs();
+	mockSetPin(GO_PIN, LOW);
+	for(unsigned int i = 1; i < SENSOR_REQUIRED_COUNT; i++) {
+		CHECK_EQUAL(0, updateSensors());
+		CHECK(!Sensor_Engaged[GO]);
+	}
+	CHECK_EQUAL(1 << GO, updateSensors());
+	CHECK(Sensor_Engaged[GO]);
+
+	// Stays engaged for as long as it is held
+	for(unsigned int i = 0; i < 1000; i++) {
+		CHECK_EQUAL(1 << GO, updateSensors());
+	}
+}
+
+TEST(sensor_releases_immediately) {
+	initOpenInputs();
+	mockSetPin(BACK_PIN, LOW);
+	for(unsigned int i = 0; i < SENSOR_REQUIRED_COUNT; i++) {
+		updateSensors();
+	}
+	CHECK(Sensor_Engaged[BACK]);
+	mockSetPin(BACK_PIN, HIGH);
+	CHECK_EQUAL(0, updateSensors());
+	CHECK(!Sensor_Engaged[BACK]);
+}
+
+TEST(sensor_glitch_restarts_count) {
+	initOpenInputs();
+	mockSetPin(FORW_PIN, LOW);
+	for(unsigned int i = 1; i < SENSOR_REQUIRED_COUNT; i++) {
+		updateSensors();
+	}
+	mockSetPin(FORW_PIN, HIGH);
+	updateSensors();
+	mockSetPin(FORW_PIN, LOW);
+	for(unsigned int i = 1; i < SENSOR_REQUIRED_COUNT; i++) {
+		updateSensors();
+		CHECK(!Sensor_Engaged[FORW]);
+	}
+	updateSensors();
+	CHECK(Sensor_Engaged[FORW]);
+}
+
+TEST(endstop_engages_high_and_drives_led) {
+	initOpenInputs();
+	updateSensors();
+	CHECK_EQUAL(HIGH, mockGetPin(ENDSTOP_0_LED_PIN));
+	mockSetPin(ENDSTOP_0_PIN, HIGH);
+	byte Mask = 0;
+	for(unsigned int i = 0; i < SENSOR_REQUIRED_COUNT; i++) {
+		Mask = updateSensors();
+	}
+	CHECK_EQUAL(1 << ENDSTOP_0, Mask);
+	CHECK_EQUAL(LOW, mockGetPin(ENDSTOP_0_LED_PIN));
+}
+
+TEST(sensors_debounce_independently) {
+	initOpenInputs();
+	mockSetPin(GO_PIN, LOW);
+	updateSensors();
+	updateSensors();
+	mockSetPin(BACK_PIN, LOW);
+	for(unsigned int i = 3; i < SENSOR_REQUIRED_COUNT; i++) {
+		CHECK_EQUAL(0, updateSensors());
+	}
+	CHECK_EQUAL(1 << GO, updateSensors());
+	CHECK_EQUAL(1 << GO, updateSensors());
+	CHECK_EQUAL((1 << GO) | (1 << BACK), updateSensors());
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include "test.h"
+#include "trace.h"
+#include "../CML-Firmware.h"
+
+extern encoder_data_t Encoder_Data;
+
+// Starts tracing with Timer0 at the start of its period
+void startTrace() {
+	mockRunTimers(true);
+	mockRunTimers(false);
+	initTrace();
+	Serial.output.clear();
+}
+
+// Lets time pass until the Timer0 count reaches a value, then runs the tick if it is due
+void advanceToCount(byte count) {
+	mockAdvance(((count - TCNT0) & 0xFF) * (MOCK_TIMER0_PERIOD / 256));
+	if(count == OCR0B) {
+		mockInterrupt(TIMER0_COMPB_vect);
+	}
+}
+
+// Changes a button and runs its pin change interrupt
+void changeButton(byte pin, byte value) {
+	mockSetPin(pin, value);
+	mockInterrupt(PCINT1_vect);
+}
+
+TEST(trace_records_sampled_changes_at_ticks) {
+	startTrace();
+	CHECK(PCICR & (1 << PCIE1));
+	for(int Tick = 0; Tick < 3; Tick++) {
+		advanceToCount(OCR0B);
+	}
+	Encoder_Data.position += 25;
+	advanceToCount(OCR0B);
+	handleTrace();
+	CHECK(Serial.output == "@4,3F,25\n");
+}
+
+TEST(trace_times_short_glitches_between_ticks) {
+	startTrace();
+	advanceToCount(OCR0B);
+	advanceToCount(OCR0B + 50);
+	changeButton(GO_PIN, LOW);
+	advanceToCount(OCR0B + 60);
+	changeButton(GO_PIN, HIGH);
+
+	// Pin change interrupts for other pins, or with no change, are ignored
+	mockInterrupt(PCINT2_vect);
+	advanceToCount(OCR0B);
+	handleTrace();
+	CHECK(Serial.output == "@1+200,1F,0\n@0+240,3F,0\n");
+}
+
+TEST(trace_counts_ticks_from_pin_changes) {
+	startTrace();
+	advanceToCount(OCR0B + 10);
+	changeButton(FORW_PIN, LOW);
+	advanceToCount(OCR0B);
+	advanceToCount(OCR0B);
+	changeButton(FORW_PIN, HIGH);
+	handleTrace();
+	CHECK(Serial.output == "@0+40,2F,0\n@2,3F,0\n");
+}
+
+TEST(trace_marks_record_holding_lost_changes) {
+	startTrace();
+
+	// Fill the buffer, then lose three changes
+	for(int Record = 0; Record < (TRACE_RECORDS + 2); Record++) {
+		Encoder_Data.position += 1;
+		advanceToCount(OCR0B);
+	}
+	handleTrace();
+	CHECK_EQUAL(TRACE_RECORDS - 1, std::count(Serial.output.begin(), Serial.output.end(), '\n'));
+	CHECK(Serial.output.find("@!") == std::string::npos);
+
+	// The lost changes are merged into the next record, which follows the lost count
+	Serial.output.clear();
+	Encoder_Data.position += 1;
+	advanceToCount(OCR0B);
+	handleTrace();
+	CHECK(Serial.output == "@!3\n@4,3F,4\n");
+}
+
+TEST(trace_counts_pending_tick_once) {
+	startTrace();
+	advanceToCount(OCR0B);
+
+	// A button changes just after the next tick, before its interrupt runs
+	mockAdvance(MOCK_TIMER0_PERIOD + 8);
+	TIFR0 |= (1 << OCF0B);
+	changeButton(BACK_PIN, LOW);
+	TIFR0 &= ~(1 << OCF0B);
+	mockInterrupt(TIMER0_COMPB_vect);
+	advanceToCount(OCR0B);
+	changeButton(BACK_PIN, HIGH);
+	handleTrace();
+	CHECK(Serial.output == "@2+8,37,0\n@1,3F,0\n");
+}
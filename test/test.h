@@ -0,0 +1,78 @@
+/* Host Test Runner
+ *
+ * Used to run the firmware's host tests
+ *
+ * Tests are declared with TEST() in any test file, and run in the order they are linked. Each test
+ * runs in its own process, so every test starts with the firmware and mock core in their power-on
+ * state, and a test that crashes or hangs does not stop the others. A test fails at its first
+ * failed CHECK(), or if it takes longer than TEST_TIMEOUT.
+ *
+ * Run with no arguments to run every test, or with test names to run only those.
+ */
+
+#ifndef test_h
+#define test_h
+#include <Arduino.h>
+
+/////////////////////////
+// CONFIGURATION VARIABLES
+/////////////////////////
+
+const unsigned int TEST_TIMEOUT = 10;  // Seconds
+
+
+/////////////////////////
+// AVAILABLE MACROS
+/////////////////////////
+
+#define TEST(name) \
+	void test_##name(); \
+	TestRegistration Test_Registration_##name(#name, test_##name); \
+	void test_##name()
+
+#define CHECK(condition) \
+	checkTrue((condition), #condition, __FILE__, __LINE__)
+
+#define CHECK_EQUAL(expected, actual) \
+	checkEqual((long) (expected), (long) (actual), #actual, __FILE__, __LINE__)
+
+
+/////////////////////////
+// AVAILABLE FUNCTIONS
+/////////////////////////
+
+class TestRegistration {
+	public:
+		TestRegistration(const char *name, void (*test)());
+};
+
+void checkTrue(bool condition, const char *text, const char *file, int line);
+/*
+ * Fails the running test if a condition is false
+ *
+ * INPUT:  Condition, its source text, source location
+ */
+
+void checkEqual(long expected, long actual, const char *text, const char *file, int line);
+/*
+ * Fails the running test if a value differs from what was expected
+ *
+ * INPUT:  Expected value, actual value, source text of the actual value, source location
+ */
+
+void runFor(unsigned long ms);
+/*
+ * Runs loop() for a while, with the timer interrupts running as on the hardware
+ *
+ * INPUT:  Milliseconds to run for
+ */
+
+void waitFor(unsigned long ms);
+/*
+ * Lets time pass without running loop(), with the timer interrupts running as on the hardware
+ *
+ * INPUT:  Milliseconds to wait for
+ */
+
+
+#endif
@@ -0,0 +1,190 @@
+# AVR Cycle Estimate
+#
+# Used by cost.sh to estimate the AVR cycles taken by a list of functions in a linked ELF
+#
+# Input is the disassembly of the ELF; FUNCTIONS is a space-separated list of names to report:
+#
+#   avr-objdump -d -C firmware.elf | awk -v FUNCTIONS="updateSensors TIMER2_OVF_vect" -f cost.awk
+#
+# Names are matched without their argument lists, and interrupt vectors may be given by their
+# vector name. For each function, the fastest and slowest paths from its entry to any exit are
+# found from its own instructions. Conditional branches and skips cost an extra cycle when taken.
+# Loops are followed once, so a function containing a loop is marked, and its slowest path is only
+# a lower bound. Functions it calls are listed, but not added; each call only adds the cycles of the
+# call instruction. Interrupt vectors also include the interrupt response and vector jump.
+
+BEGIN {
+	split("INT0 INT1 PCINT0 PCINT1 PCINT2 WDT TIMER2_COMPA TIMER2_COMPB TIMER2_OVF TIMER1_CAPT " \
+		"TIMER1_COMPA TIMER1_COMPB TIMER1_OVF TIMER0_COMPA TIMER0_COMPB TIMER0_OVF SPI_STC " \
+		"USART_RX USART_UDRE USART_TX ADC EE_READY ANALOG_COMP TWI SPM_READY", VECTOR_NAMES, " ")
+	for(i = 1; i in VECTOR_NAMES; i++) {
+		vector[VECTOR_NAMES[i] "_vect"] = "__vector_" i
+	}
+	n = split(FUNCTIONS, wanted, " ")
+	for(i = 1; i <= n; i++) {
+		symbol = ((wanted[i] in vector) ? vector[wanted[i]] : wanted[i])
+		report[symbol] = wanted[i]
+	}
+
+	# Interrupt response (4) and vector jump (3)
+	ISR_ENTRY_CYCLES = 7
+
+	split("adiw sbiw mul muls mulsu fmul fmuls fmulsu ld ldd lds st std sts push pop cbi sbi " \
+		"rjmp ijmp", list, " ")
+	for(i in list) {
+		cycles[list[i]] = 2
+	}
+	split("jmp rcall icall lpm elpm", list, " ")
+	for(i in list) {
+		cycles[list[i]] = 3
+	}
+	split("call ret reti", list, " ")
+	for(i in list) {
+		cycles[list[i]] = 4
+	}
+	printf("%-28s %6s %6s %6s %6s\n", "FUNCTION", "INSNS", "BYTES", "MIN", "MAX")
+}
+
+function hex(text,   i, digit, value) {
+	value = 0
+	for(i = 1; i <= length(text); i++) {
+		digit = index("0123456789abcdef", substr(text, i, 1))
+		if(digit == 0) {
+			break
+		}
+		value = (value * 16) + digit - 1
+	}
+	return value
+}
+
+function targetAddress(line) {
+	if(!match(line, /; 0x[0-9a-f]+/)) {
+		return -1
+	}
+	return hex(substr(line, RSTART + 4, RLENGTH - 4))
+}
+
+# Finds the fastest and slowest paths through the function just read, working back from its end
+function finish(   i, base, fall, taken, extra, lo, hi, entry, name) {
+	if(current == "") {
+		return
+	}
+	for(i = count; i >= 1; i--) {
+		base = ((op[i] in cycles) ? cycles[op[i]] : 1)
+		fall = ((i < count) ? (i + 1) : 0)
+		taken = 0
+		if((op[i] ~ /^(ret|reti|ijmp)$/) || (((op[i] == "jmp") || (op[i] == "rjmp")) && !(target[i] in index_of))) {
+			fast[i] = slow[i] = base
+			continue
+		}
+		if((op[i] == "jmp") || (op[i] == "rjmp")) {
+			fall = 0
+			taken = index_of[target[i]]
+		}
+		else if(op[i] ~ /^br/) {
+			taken = ((target[i] in index_of) ? index_of[target[i]] : 0)
+		}
+		else if((op[i] ~ /^(cpse|sbrc|sbrs|sbic|sbis)$/) && (i + 2 <= count)) {
+			taken = i + 2
+		}
+
+		# Loops are only followed once
+		if(taken <= i) {
+			if(taken > 0) {
+				loop = 1
+			}
+			taken = 0
+		}
+		if(fall > 0) {
+			lo = fast[fall]
+			hi = slow[fall]
+		}
+		if(taken > 0) {
+			extra = ((op[i] ~ /^br/) ? 1 : (size[i + 1] / 2))
+			if((fall == 0) || (fast[taken] + extra < lo)) {
+				lo = fast[taken] + extra
+			}
+			if((fall == 0) || (slow[taken] + extra > hi)) {
+				hi = slow[taken] + extra
+			}
+		}
+		if((fall == 0) && (taken == 0)) {
+			lo = hi = 0
+		}
+		fast[i] = base + lo
+		slow[i] = base + hi
+	}
+	entry = ((current ~ /^__vector_/) ? ISR_ENTRY_CYCLES : 0)
+	name = report[current]
+	if(loop) {
+		name = name " (loop)"
+	}
+	printf("%-28s %6d %6d %6d %6d\n", name, count, bytes, fast[1] + entry, slow[1] + entry)
+	if(callees != "") {
+		printf("  calls%s\n", callees)
+	}
+	found[current] = 1
+	current = ""
+}
+
+# Start of a function
+/^[0-9a-f]+ <.*>:$/ {
+	finish()
+	name = $0
+	sub(/^[0-9a-f]+ </, "", name)
+	sub(/>:$/, "", name)
+	sub(/\(.*$/, "", name)
+	if(!(name in report) || (name in found)) {
+		next
+	}
+	current = name
+	count = bytes = loop = 0
+	callees = ""
+	delete index_of
+	delete seen
+	next
+}
+
+# Instructions
+(current != "") && /^ +[0-9a-f]+:\t/ {
+	split($0, field, "\t")
+	count += 1
+	address = field[1]
+	sub(/^ +/, "", address)
+	index_of[hex(address)] = count
+	op[count] = field[3]
+	size[count] = split(field[2], list, " ")
+	bytes += size[count]
+	target[count] = targetAddress($0)
+	if((op[count] ~ /call$/) && match($0, /<.*>/)) {
+		callee = substr($0, RSTART + 1, RLENGTH - 2)
+		sub(/\(.*$/, "", callee)
+		if(!(callee in seen)) {
+			seen[callee] = 1
+			callees = callees " " callee
+		}
+	}
+	else if(op[count] == "icall") {
+		if(!("(indirect)" in seen)) {
+			seen["(indirect)"] = 1
+			callees = callees " (indirect)"
+		}
+	}
+	next
+}
+
+# End of the function's instructions
+(current != "") && /^$/ {
+	finish()
+}
+
+END {
+	finish()
+	for(symbol in report) {
+		if(!(symbol in found)) {
+			printf("%-28s not found (inlined?)\n", report[symbol])
+			missing = 1
+		}
+	}
+	exit missing
+}
@@ -0,0 +1,38 @@
+#!/bin/sh
+# AVR Cost Report
+#
+# Estimates the AVR cycles taken by the Firmware's hot paths in a compiled build, to go alongside
+# the host timings of the same functions from "make -C test bench", which can't show their cost on
+# the ATmega 328P.
+#
+# The build must keep its ELF, for example:
+#
+#   arduino-cli compile -b arduino:avr:uno --build-path build .
+#   tools/cost.sh build
+#   tools/cost.sh build loop TIMER0_COMPB_vect    # Reports other functions or interrupt vectors
+#
+# For each function, the instructions and bytes it contains are reported, with the cycles taken by
+# its fastest and slowest paths. Loops are only followed once, and the functions it calls are
+# listed but not included, so these are estimates of the function's own cost. See cost.awk for
+# details. Functions inlined into every caller can't be reported.
+
+OBJDUMP=${OBJDUMP:-avr-objdump}
+FUNCTIONS="updateSensors getBlinksNext handleErrorCodeDisplay TIMER2_OVF_vect TIMER1_OVF_vect"
+
+BUILD=$1
+if [ -z "$BUILD" ] || [ ! -d "$BUILD" ]; then
+	echo "usage: $0 <build path> [function...]" >&2
+	exit 2
+fi
+shift
+if [ $# -gt 0 ]; then
+	FUNCTIONS="$*"
+fi
+
+ELF=$(find "$BUILD" -maxdepth 1 -name '*.elf' | head -n 1)
+if [ -z "$ELF" ]; then
+	echo "no ELF found in $BUILD" >&2
+	exit 2
+fi
+
+$OBJDUMP -d -C "$ELF" | awk -v FUNCTIONS="$FUNCTIONS" -f "$(dirname "$0")/cost.awk"
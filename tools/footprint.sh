@@ -0,0 +1,88 @@
+#!/bin/sh
+# Firmware Footprint Report
+#
+# Reports the RAM and flash used by each module of a compiled build, along with the peak stack
+# depth, and fails if any budget is exceeded.
+#
+# The build must keep its object files and ELF, for example:
+#
+#   arduino-cli compile -b arduino:avr:uno --build-path build .
+#   tools/footprint.sh build
+#
+# Stack depth is found from the call graph of the linked ELF. Each function's frame is measured
+# from its disassembly (pushed registers and any frame allocated in its prologue), and each call
+# adds its 2-byte return address. The deepest chain is found from main() and from every interrupt
+# vector, following direct calls and tail jumps. Indirect calls (such as virtual Print::write()
+# calls made by Serial.print()) are assumed to reach the deepest function that is never called
+# directly. Interrupts only nest if a function in their call tree re-enables interrupts with
+# "sei"; if any does, every interrupt is assumed to nest, otherwise only the deepest interrupt
+# is added to the main chain. The result is an upper bound, unless recursion is found; recursion
+# cannot be bounded, so the result is then reported as a lower bound, and only fails the stack
+# check if even the lower bound does not fit.
+#
+# Budgets are in bytes and may be overridden from the environment.
+
+RAM_SIZE=${RAM_SIZE:-2048}
+RAM_BUDGET=${RAM_BUDGET:-1536}
+FLASH_BUDGET=${FLASH_BUDGET:-32256}
+SIZE=${SIZE:-avr-size}
+OBJDUMP=${OBJDUMP:-avr-objdump}
+
+BUILD=$1
+if [ -z "$BUILD" ] || [ ! -d "$BUILD" ]; then
+	echo "usage: $0 <build path>" >&2
+	exit 2
+fi
+
+ELF=$(find "$BUILD" -maxdepth 1 -name '*.elf' | head -n 1)
+OBJECTS=$(find "$BUILD/sketch" -name '*.o' | sort)
+if [ -z "$ELF" ] || [ -z "$OBJECTS" ]; then
+	echo "no ELF or object files found in $BUILD" >&2
+	exit 2
+fi
+
+# Per-module static usage
+echo "MODULE                         TEXT   DATA    BSS  FLASH    RAM"
+for OBJECT in $OBJECTS; do
+	$SIZE -B "$OBJECT" | awk -v name="$(basename "$OBJECT" .o)" 'NR == 2 {
+		printf("%-28s %6d %6d %6d %6d %6d\n", name, $1, $2, $3, $1 + $2, $2 + $3)
+	}'
+done
+
+# Totals, including the Arduino core and libraries
+TOTALS=$($SIZE -A "$ELF" | awk '
+	$1 == ".text" { text = $2 }
+	$1 == ".data" { data = $2 }
+	$1 == ".bss" { bss = $2 }
+	$1 == ".noinit" { noinit = $2 }
+	END { print text + data, data + bss + noinit }')
+FLASH_USED=${TOTALS% *}
+RAM_USED=${TOTALS#* }
+
+# Peak stack depth, from the call graph
+echo
+STACK=$({ $OBJDUMP -t -C "$ELF"; echo DISASSEMBLY; $OBJDUMP -d -C "$ELF"; } | awk -f "$(dirname "$0")/stack.awk")
+STACK_BOUND=${STACK#* }
+STACK=${STACK%% *}
+STACK=${STACK:-0}
+
+echo
+echo "FLASH: $FLASH_USED / $FLASH_BUDGET bytes"
+echo "RAM:   $RAM_USED / $RAM_BUDGET bytes static, $STACK bytes peak stack ($STACK_BOUND), $RAM_SIZE bytes total"
+
+STATUS=0
+if [ "$FLASH_USED" -gt "$FLASH_BUDGET" ]; then
+	echo "FLASH BUDGET EXCEEDED" >&2
+	STATUS=1
+fi
+if [ "$RAM_USED" -gt "$RAM_BUDGET" ]; then
+	echo "RAM BUDGET EXCEEDED" >&2
+	STATUS=1
+fi
+if [ $((RAM_USED + STACK)) -gt "$RAM_SIZE" ]; then
+	echo "STACK MAY OVERFLOW RAM" >&2
+	STATUS=1
+elif [ "$STACK_BOUND" != "upper bound" ]; then
+	echo "STACK DEPTH UNBOUNDED (RECURSION); NOT CHECKED" >&2
+fi
+exit $STATUS
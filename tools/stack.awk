@@ -0,0 +1,207 @@
+# Stack Depth Estimate
+#
+# Used by footprint.sh to find the peak stack depth from the call graph of a linked ELF
+#
+# Input is the symbol table and disassembly of the ELF, separated by a line reading "DISASSEMBLY":
+#
+#   { avr-objdump -t -C firmware.elf; echo DISASSEMBLY; avr-objdump -d -C firmware.elf; } | awk -f stack.awk
+#
+# The deepest chain from main() and from each interrupt vector are printed to stderr, and the peak
+# stack depth is printed to stdout, followed by "upper bound", or "lower bound" if recursion was found.
+
+BEGIN {
+	SEP = "\034"
+	INDIRECT = "(indirect call)"
+	split("INT0 INT1 PCINT0 PCINT1 PCINT2 WDT TIMER2_COMPA TIMER2_COMPB TIMER2_OVF TIMER1_CAPT " \
+		"TIMER1_COMPA TIMER1_COMPB TIMER1_OVF TIMER0_COMPA TIMER0_COMPB TIMER0_OVF SPI_STC " \
+		"USART_RX USART_UDRE USART_TX ADC EE_READY ANALOG_COMP TWI SPM_READY", VECTOR_NAMES, " ")
+}
+
+function targetOf(line,   name) {
+	if(!match(line, /; 0x[0-9a-f]+ </)) {
+		return ""
+	}
+	name = substr(line, RSTART + RLENGTH)
+	sub(/>[ \t]*$/, "", name)
+	return ((name ~ /\+0x[0-9a-f]+$/) ? "" : name)
+}
+
+function immediate(args,   text, i, digit, value) {
+	text = args
+	sub(/^[^,]*, *0x/, "", text)
+	value = 0
+	for(i = 1; i <= length(text); i++) {
+		digit = index("0123456789abcdef", substr(text, i, 1))
+		if(digit == 0) {
+			break
+		}
+		value = (value * 16) + digit - 1
+	}
+	return value
+}
+
+function addCall(from, to) {
+	if((to == "") || (to == from) || ((from SEP to) in edge)) {
+		return
+	}
+	edge[from SEP to] = 1
+	callees[from] = callees[from] SEP to
+	called[to] = 1
+}
+
+function depth(f,   list, n, i, d, best) {
+	if(f in memo) {
+		return memo[f]
+	}
+	if(f in visiting) {
+		recursive = 1
+		return 0
+	}
+	visiting[f] = 1
+	if(f in calls_self) {
+		recursive = 1
+	}
+	best = 0
+	enables[f] = (f in sei)
+	n = split(callees[f], list, SEP)
+	for(i = 2; i <= n; i++) {
+		d = depth(list[i]) + ((list[i] == INDIRECT) ? 0 : 2)
+		if(d > best) {
+			best = d
+			deepest[f] = list[i]
+		}
+		if(enables[list[i]]) {
+			enables[f] = 1
+		}
+	}
+	delete visiting[f]
+	memo[f] = frame[f] + best
+	return memo[f]
+}
+
+function chain(f,   text) {
+	text = f
+	while(f in deepest) {
+		f = deepest[f]
+		text = text " > " f
+	}
+	return text
+}
+
+# Symbol table; only function symbols are part of the call graph
+!disassembly && ($0 == "DISASSEMBLY") {
+	disassembly = 1
+	next
+}
+!disassembly {
+	if($0 ~ /[ \t]F[ \t]+\.text\t/) {
+		name = $0
+		sub(/^.*\t[0-9a-f]+ +/, "", name)
+		if(name !~ /^\./) {
+			function_sym[name] = 1
+		}
+	}
+	next
+}
+
+# Start of a function
+/^[0-9a-f]+ <.*>:$/ {
+	current = $0
+	sub(/^[0-9a-f]+ </, "", current)
+	sub(/>:$/, "", current)
+	if(!(current in function_sym)) {
+		current = ""
+		next
+	}
+	frame[current] = 0
+	in_prologue = 1
+	frame_pointer = 0
+	next
+}
+
+# Instructions
+(current != "") && /^ +[0-9a-f]+:\t/ {
+	split($0, field, "\t")
+	op = field[3]
+	args = field[4]
+	if(op == "push") {
+		frame[current] += 1
+	}
+	else if((op == "rcall") && (args ~ /^\.\+0 *$/)) {
+		if(in_prologue) {
+			frame[current] += 2
+		}
+	}
+	else if((op == "call") || (op == "rcall") || (op == "jmp") || (op == "rjmp")) {
+		target = targetOf($0)
+		if((target == current) && (op ~ /call/)) {
+			calls_self[current] = 1
+		}
+		addCall(current, target)
+	}
+	else if((op == "icall") || (op == "eicall")) {
+		addCall(current, INDIRECT)
+	}
+	else if(op == "sei") {
+		sei[current] = 1
+	}
+
+	# Frame allocated in the prologue: Y = SP, Y -= size, SP = Y
+	else if(in_prologue && (op == "in") && (args ~ /^r28, 0x3d/)) {
+		frame_pointer = 1
+	}
+	else if(in_prologue && frame_pointer && (op == "sbiw") && (args ~ /^r28, /)) {
+		frame[current] += immediate(args)
+	}
+	else if(in_prologue && frame_pointer && (op == "subi") && (args ~ /^r28, /)) {
+		frame_low = immediate(args)
+	}
+	else if(in_prologue && frame_pointer && (op == "sbci") && (args ~ /^r29, /)) {
+		frame[current] += (immediate(args) * 256) + frame_low
+	}
+	else if(in_prologue && (op == "out") && (args ~ /^0x3d, /)) {
+		in_prologue = 0
+	}
+	next
+}
+
+END {
+	# Indirect calls may reach any function that is never called directly
+	frame[INDIRECT] = 0
+	for(f in function_sym) {
+		if(!(f in called) && (f != "main") && (f !~ /^__/)) {
+			addCall(INDIRECT, f)
+		}
+	}
+
+	# main() and each interrupt are entered with a 2-byte return address on the stack
+	main_depth = depth("main") + 2
+	printf("  %-14s %5d  %s\n", "main", main_depth, chain("main")) > "/dev/stderr"
+
+	isr_max = 0
+	isr_sum = 0
+	nested = ""
+	for(f in function_sym) {
+		if(f !~ /^__vector_[0-9]+$/) {
+			continue
+		}
+		number = substr(f, 10) + 0
+		isr_depth = depth(f) + 2
+		isr_sum += isr_depth
+		if(isr_depth > isr_max) {
+			isr_max = isr_depth
+		}
+		if(enables[f]) {
+			nested = nested " " VECTOR_NAMES[number]
+		}
+		printf("  %-14s %5d  %s\n", ((number in VECTOR_NAMES) ? VECTOR_NAMES[number] : f), isr_depth, chain(f)) > "/dev/stderr"
+	}
+	if(nested != "") {
+		printf("  Interrupts re-enabled by:%s; assuming all interrupts nest\n", nested) > "/dev/stderr"
+	}
+	if(recursive) {
+		printf("  Recursion found; depth of recursive calls not counted\n") > "/dev/stderr"
+	}
+
+	print main_depth + ((nested != "") ? isr_sum : isr_max), (recursive ? "lower bound" : "upper bound")
+}